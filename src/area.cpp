@@ -1,5 +1,6 @@
 #include "area.hpp"
 #include <algorithm>
+#include <stdexcept>
 
 void Interval::set_bounds(double left, double right) {
     bounds = {{left, right}};
@@ -23,21 +24,26 @@ const std::vector<std::pair<double, double>>& Rectangle::get_bounding_box() cons
     return bounds;
 }
 
-std::vector<double> Rectangle::sample_random_point(std::mt19937& gen) const {
-    std::uniform_real_distribution<> dist(0., 1.);
-    std::vector<double> res;
-    res.reserve(bounds.size());
-    // for (size_t i = 0; i < bounds.size(); ++i) {
-    //     double alpha = dist(gen);
-    //     res.push_back(bounds[i].first + (bounds[i].second - bounds[i].first) * alpha);
-    // }
-    for (auto it = bounds.begin(); it != bounds.end(); ++it) {
-        double alpha = dist(gen);
-        res.push_back((*it).first + ((*it).second - (*it).first) * alpha);
+std::vector<double> Rectangle::sample_random_point(Philox4x32& gen) const {
+    std::vector<double> res(bounds.size());
+    gen.fill_uniform(res.data(), res.size());
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        res[i] = bounds[i].first + (bounds[i].second - bounds[i].first) * res[i];
     }
     return res;
 } 
 
+std::vector<double> Rectangle::sample_point(Sampler& sampler) const {
+    if (sampler.get_dim() != bounds.size()) {
+        throw std::invalid_argument("Sampler has incompatible dimention.");
+    }
+    std::vector<double> res = sampler.next();
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        res[i] = bounds[i].first + (bounds[i].second - bounds[i].first) * res[i];
+    }
+    return res;
+}
+
 Rectangle Rectangle::intersect_rectangle(const Rectangle& other) const {
     if (other.bounds.size() != bounds.size())
         throw "Rectangle sizes are incompatible";
@@ -5,6 +5,9 @@
 #include <random>
 #include <iostream>
 
+#include "rng.hpp"
+#include "sampler.hpp"
+
 /**
  * @brief Base class for the area that implements rectangle.
  * 
@@ -38,11 +41,21 @@ public:
 
     /**
      * @brief Samples random point inside the rectangle.
+     * Uniform numbers for all coordinates are generated in one block.
      * 
      * @param gen 
      * @return std::vector<double> 
      */
-    virtual std::vector<double> sample_random_point(std::mt19937& gen) const;
+    virtual std::vector<double> sample_random_point(Philox4x32& gen) const;
+
+    /**
+     * @brief Maps the next point of sampler from the unit cube
+     * into the rectangle.
+     * 
+     * @param sampler must have the dimention of the rectangle
+     * @return std::vector<double> 
+     */
+    virtual std::vector<double> sample_point(Sampler& sampler) const;
 
     /**
      * @brief Returns intersection of two rectangles.
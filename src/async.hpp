@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Shared flag used to stop a running optimization.
+ * Copies refer to the same flag.
+ *
+ */
+class CancellationToken {
+public:
+    CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() {flag->store(true, std::memory_order_relaxed);}
+    bool is_cancelled() const {return flag->load(std::memory_order_relaxed);}
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+/**
+ * @brief Snapshot of optimization state published once per iteration.
+ *
+ */
+struct Progress {
+    size_t iteration;
+    double best_value;
+    /// NaN for methods that do not compute gradients
+    double gradient_norm;
+};
+
+/**
+ * @brief Bounded lock-free queue for one producer and one consumer thread.
+ *
+ * @tparam V stored value type
+ */
+template <typename V>
+class SPSCQueue {
+public:
+    /**
+     * @brief Construct a new SPSCQueue object
+     *
+     * @param capacity rounded up to a power of two
+     */
+    SPSCQueue(size_t capacity = 1024);
+
+    /**
+     * @brief Called by the producer. Never blocks.
+     *
+     * @param value
+     * @return true, if value was queued
+     * @return false, if queue is full
+     */
+    bool try_push(const V& value);
+
+    /**
+     * @brief Called by the consumer. Never blocks.
+     *
+     * @param value receives the oldest element
+     * @return true, if element was taken
+     * @return false, if queue is empty
+     */
+    bool try_pop(V& value);
+
+private:
+    std::vector<V> buffer;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+using ProgressChannel = SPSCQueue<Progress>;
+
+
+template <typename V>
+SPSCQueue<V>::SPSCQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    buffer.resize(size);
+    mask = size - 1;
+}
+
+template <typename V>
+bool SPSCQueue<V>::try_push(const V& value) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == buffer.size()) return false;
+    buffer[t & mask] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename V>
+bool SPSCQueue<V>::try_pop(V& value) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return false;
+    value = buffer[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
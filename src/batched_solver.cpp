@@ -0,0 +1,281 @@
+#include "batched_solver.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+BatchAdapter::BatchAdapter(std::shared_ptr<const Function<>> func) :
+    BatchFunction(func->get_dim()), func(std::move(func)) {}
+
+void BatchAdapter::values(const BatchPoints& x, std::vector<double>& value) const {
+    std::vector<double> point(dim);
+    for (size_t k = 0; k < value.size(); ++k) {
+        for (size_t i = 0; i < dim; ++i) point[i] = x[i][k];
+        value[k] = (*func)(point);
+    }
+}
+
+void BatchAdapter::gradients(const BatchPoints& x, BatchPoints& grad) const {
+    std::vector<double> point(dim);
+    for (size_t k = 0; k < x[0].size(); ++k) {
+        for (size_t i = 0; i < dim; ++i) point[i] = x[i][k];
+        std::vector<double> g = func->get_gradient(point);
+        for (size_t i = 0; i < dim; ++i) grad[i][k] = g[i];
+    }
+}
+
+void BatchFunc1::values(const BatchPoints& x, std::vector<double>& value) const {
+    const double* x0 = x[0].data();
+    const double* x1 = x[1].data();
+    double* v = value.data();
+    for (size_t k = 0; k < value.size(); ++k) {
+        v[k] = (x0[k] + 1) * (x1[k] - 1);
+    }
+}
+
+void BatchFunc1::gradients(const BatchPoints& x, BatchPoints& grad) const {
+    const double* x0 = x[0].data();
+    const double* x1 = x[1].data();
+    double* g0 = grad[0].data();
+    double* g1 = grad[1].data();
+    for (size_t k = 0; k < x[0].size(); ++k) {
+        g0[k] = x1[k] - 1;
+        g1[k] = x0[k] + 1;
+    }
+}
+
+void BatchFunc3dim2::values(const BatchPoints& x, std::vector<double>& value) const {
+    const double* x0 = x[0].data();
+    const double* x1 = x[1].data();
+    const double* x2 = x[2].data();
+    double* v = value.data();
+    for (size_t k = 0; k < value.size(); ++k) {
+        v[k] = (x0[k] - 0.5) * (x0[k] - 0.5) + (x1[k] + 0.5) * (x1[k] + 0.5) + x2[k] * x2[k];
+    }
+}
+
+void BatchFunc3dim2::gradients(const BatchPoints& x, BatchPoints& grad) const {
+    const double* x0 = x[0].data();
+    const double* x1 = x[1].data();
+    const double* x2 = x[2].data();
+    double* g0 = grad[0].data();
+    double* g1 = grad[1].data();
+    double* g2 = grad[2].data();
+    for (size_t k = 0; k < x[0].size(); ++k) {
+        g0[k] = 2 * x0[k] - 1;
+        g1[k] = 2 * x1[k] + 1;
+        g2[k] = 2 * x2[k];
+    }
+}
+
+void BatchFunc4dim1::values(const BatchPoints& x, std::vector<double>& value) const {
+    double* v = value.data();
+    for (size_t k = 0; k < value.size(); ++k) v[k] = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        const double* xi = x[i].data();
+        for (size_t k = 0; k < value.size(); ++k) {
+            v[k] += std::sin(xi[k]);
+        }
+    }
+}
+
+void BatchFunc4dim1::gradients(const BatchPoints& x, BatchPoints& grad) const {
+    for (size_t i = 0; i < dim; ++i) {
+        const double* xi = x[i].data();
+        double* gi = grad[i].data();
+        for (size_t k = 0; k < x[i].size(); ++k) {
+            gi[k] = std::cos(xi[k]);
+        }
+    }
+}
+
+
+namespace {
+
+void check_problem(const BatchProblem& problem, const BatchFunction& func) {
+    size_t dim = func.get_dim();
+    if (problem.x0.size() != dim || problem.lower.size() != dim || problem.upper.size() != dim) {
+        throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
+    }
+    for (size_t i = 0; i < dim; ++i) {
+        if (problem.x0[i].size() != problem.get_count() ||
+            problem.lower[i].size() != problem.get_count() ||
+            problem.upper[i].size() != problem.get_count()) {
+            throw std::invalid_argument("Batch coordinates have different sizes.");
+        }
+    }
+}
+
+}
+
+BatchedConjugateGradient::BatchedConjugateGradient(
+    size_t max_iters, double epsilon, double line_search_epsilon
+) : max_iters(max_iters), epsilon(epsilon), line_search_epsilon(line_search_epsilon) {}
+
+BatchResult BatchedConjugateGradient::optimize(const BatchProblem& problem, const BatchFunction& func) const {
+    check_problem(problem, func);
+    const size_t dim = func.get_dim();
+    const size_t count = problem.get_count();
+
+    BatchPoints x = problem.x0;
+    BatchPoints p(dim, std::vector<double>(count));
+    BatchPoints g(dim, std::vector<double>(count));
+    BatchPoints probe(dim, std::vector<double>(count));
+    std::vector<double> gg(count, 0.), num(count), left(count), right(count),
+                        derivative(count), step(count);
+    // uint8_t instead of bool keeps masks in plain vectorizable arrays
+    std::vector<std::uint8_t> active(count, 1), searching(count);
+    std::vector<size_t> iters(count, 0);
+
+    func.gradients(x, g);
+    for (size_t i = 0; i < dim; ++i) {
+        for (size_t k = 0; k < count; ++k) {
+            p[i][k] = -g[i][k];
+            gg[k] += g[i][k] * g[i][k];
+        }
+    }
+
+    size_t remaining = count;
+    while (remaining) {
+        // distance to the box along p
+        for (size_t k = 0; k < count; ++k) {
+            left[k] = 0;
+            right[k] = std::numeric_limits<double>::max();
+        }
+        for (size_t i = 0; i < dim; ++i) {
+            for (size_t k = 0; k < count; ++k) {
+                double r = (problem.upper[i][k] - x[i][k]) / p[i][k];
+                double l = (problem.lower[i][k] - x[i][k]) / p[i][k];
+                right[k] = std::min(right[k], std::max(r, l));
+            }
+        }
+
+        // bisection on the sign of the directional derivative
+        while (true) {
+            size_t any = 0;
+            for (size_t k = 0; k < count; ++k) {
+                searching[k] = active[k] & (right[k] - left[k] > line_search_epsilon);
+                any += searching[k];
+            }
+            if (!any) break;
+            for (size_t i = 0; i < dim; ++i) {
+                for (size_t k = 0; k < count; ++k) {
+                    probe[i][k] = x[i][k] + (left[k] + right[k]) / 2 * p[i][k];
+                }
+            }
+            func.gradients(probe, g);
+            for (size_t k = 0; k < count; ++k) derivative[k] = 0;
+            for (size_t i = 0; i < dim; ++i) {
+                for (size_t k = 0; k < count; ++k) {
+                    derivative[k] += g[i][k] * p[i][k];
+                }
+            }
+            for (size_t k = 0; k < count; ++k) {
+                double mi = (left[k] + right[k]) / 2;
+                bool go_right = searching[k] && derivative[k] < 0;
+                bool go_left = searching[k] && !(derivative[k] < 0);
+                left[k] = go_right ? mi : left[k];
+                right[k] = go_left ? mi : right[k];
+            }
+        }
+
+        for (size_t k = 0; k < count; ++k) step[k] = 0;
+        for (size_t i = 0; i < dim; ++i) {
+            for (size_t k = 0; k < count; ++k) {
+                double delta = active[k] ? (left[k] + right[k]) / 2 * p[i][k] : 0.;
+                x[i][k] += delta;
+                step[k] += delta * delta;
+            }
+        }
+
+        func.gradients(x, g);
+        for (size_t k = 0; k < count; ++k) num[k] = 0;
+        for (size_t i = 0; i < dim; ++i) {
+            for (size_t k = 0; k < count; ++k) {
+                num[k] += g[i][k] * g[i][k];
+            }
+        }
+
+        remaining = 0;
+        for (size_t k = 0; k < count; ++k) {
+            iters[k] += active[k];
+            bool stop = iters[k] >= max_iters || (iters[k] > 1 && step[k] < epsilon * epsilon) ||
+                        gg[k] < 1e-8 || num[k] < 1e-10;
+            active[k] = active[k] & !stop;
+            remaining += active[k];
+        }
+
+        for (size_t i = 0; i < dim; ++i) {
+            for (size_t k = 0; k < count; ++k) {
+                double beta = num[k] / gg[k];
+                p[i][k] = active[k] ? -g[i][k] + beta * p[i][k] : p[i][k];
+            }
+        }
+        for (size_t k = 0; k < count; ++k) {
+            gg[k] = active[k] ? num[k] : gg[k];
+        }
+    }
+
+    BatchResult res;
+    res.minimum_value.resize(count);
+    func.values(x, res.minimum_value);
+    res.minimum_point = std::move(x);
+    res.iter_number = std::move(iters);
+    return res;
+}
+
+
+BatchedRandomSearch::BatchedRandomSearch(
+    double delta0, double p, size_t max_iters, std::uint64_t seed, double alpha, double min_delta
+) : delta0(delta0), p(p), max_iters(max_iters), seed(seed), alpha(alpha), min_delta(min_delta) {}
+
+BatchResult BatchedRandomSearch::optimize(const BatchProblem& problem, const BatchFunction& func) const {
+    check_problem(problem, func);
+    const size_t dim = func.get_dim();
+    const size_t count = problem.get_count();
+
+    BatchPoints x = problem.x0;
+    BatchPoints y(dim, std::vector<double>(count));
+    std::vector<double> fx(count), fy(count), delta(count, delta0);
+    std::vector<std::uint8_t> neighborhood(count), accepted(count);
+    std::vector<Philox4x32> gens;
+    gens.reserve(count);
+    for (size_t k = 0; k < count; ++k) {
+        gens.emplace_back(seed, k);
+    }
+
+    func.values(x, fx);
+    for (size_t iter = 0; iter < max_iters; ++iter) {
+        // sampling is per problem, evaluation and acceptance are lockstep
+        for (size_t k = 0; k < count; ++k) {
+            neighborhood[k] = gens[k].uniform() < p && delta[k] > min_delta;
+            for (size_t i = 0; i < dim; ++i) {
+                double lo = problem.lower[i][k];
+                double hi = problem.upper[i][k];
+                if (neighborhood[k]) {
+                    lo = std::max(lo, x[i][k] - delta[k] / 2);
+                    hi = std::min(hi, x[i][k] + delta[k] / 2);
+                }
+                y[i][k] = lo + (hi - lo) * gens[k].uniform();
+            }
+        }
+        func.values(y, fy);
+        for (size_t k = 0; k < count; ++k) {
+            accepted[k] = fy[k] < fx[k];
+            delta[k] = accepted[k] && neighborhood[k] ? alpha * delta[k] : delta[k];
+            fx[k] = accepted[k] ? fy[k] : fx[k];
+        }
+        for (size_t i = 0; i < dim; ++i) {
+            for (size_t k = 0; k < count; ++k) {
+                x[i][k] = accepted[k] ? y[i][k] : x[i][k];
+            }
+        }
+    }
+
+    BatchResult res;
+    res.minimum_point = std::move(x);
+    res.minimum_value = std::move(fx);
+    res.iter_number.assign(count, max_iters);
+    return res;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "function.hpp"
+#include "rng.hpp"
+
+/**
+ * @brief Batch of points in structure of arrays layout:
+ * x[i][k] is coordinate i of problem k.
+ *
+ */
+using BatchPoints = std::vector<std::vector<double>>;
+
+/**
+ * @brief Function evaluated for many points at once. Implementations
+ * loop over problems in the innermost loop, so one SIMD lane
+ * handles one problem.
+ *
+ */
+class BatchFunction {
+protected:
+    size_t dim;
+public:
+    BatchFunction(size_t dim) : dim(dim) {}
+    virtual ~BatchFunction() = default;
+
+    size_t get_dim() const {return dim;}
+
+    /**
+     * @brief value[k] = f(x_k) for every problem k.
+     *
+     * @param x
+     * @param value
+     */
+    virtual void values(const BatchPoints& x, std::vector<double>& value) const = 0;
+
+    /**
+     * @brief grad[i][k] = df/dx_i (x_k) for every problem k.
+     *
+     * @param x
+     * @param grad
+     */
+    virtual void gradients(const BatchPoints& x, BatchPoints& grad) const = 0;
+};
+
+/**
+ * @brief Evaluates any scalar function problem by problem.
+ *
+ */
+class BatchAdapter : public BatchFunction {
+    std::shared_ptr<const Function<>> func;
+public:
+    BatchAdapter(std::shared_ptr<const Function<>> func);
+    void values(const BatchPoints& x, std::vector<double>& value) const override;
+    void gradients(const BatchPoints& x, BatchPoints& grad) const override;
+};
+
+/**
+ * @brief Batched (x + 1)(y - 1), same as Func1.
+ *
+ */
+class BatchFunc1 : public BatchFunction {
+public:
+    BatchFunc1() : BatchFunction(2) {}
+    void values(const BatchPoints& x, std::vector<double>& value) const override;
+    void gradients(const BatchPoints& x, BatchPoints& grad) const override;
+};
+
+/**
+ * @brief Batched (x - 0.5)^2 + (y + 0.5)^2 + z^2, same as Func3dim2.
+ *
+ */
+class BatchFunc3dim2 : public BatchFunction {
+public:
+    BatchFunc3dim2() : BatchFunction(3) {}
+    void values(const BatchPoints& x, std::vector<double>& value) const override;
+    void gradients(const BatchPoints& x, BatchPoints& grad) const override;
+};
+
+/**
+ * @brief Batched sin(x) + sin(y) + sin(z) + sin(w), same as Func4dim1.
+ *
+ */
+class BatchFunc4dim1 : public BatchFunction {
+public:
+    BatchFunc4dim1() : BatchFunction(4) {}
+    void values(const BatchPoints& x, std::vector<double>& value) const override;
+    void gradients(const BatchPoints& x, BatchPoints& grad) const override;
+};
+
+/**
+ * @brief Independent box constrained problems sharing one function.
+ *
+ */
+struct BatchProblem {
+    BatchPoints lower;
+    BatchPoints upper;
+    BatchPoints x0;
+
+    size_t get_count() const {return x0.empty() ? 0 : x0[0].size();}
+};
+
+struct BatchResult {
+    BatchPoints minimum_point;
+    std::vector<double> minimum_value;
+    std::vector<size_t> iter_number;
+};
+
+/**
+ * @brief Conjugate gradient method advancing all problems of a batch
+ * in lockstep. Converged problems are masked out and keep their point.
+ * Stops a problem after max_iters iterations or when two successive
+ * points differ by less than epsilon.
+ *
+ */
+class BatchedConjugateGradient {
+public:
+    BatchedConjugateGradient(size_t max_iters = 100, double epsilon = 1e-6,
+                             double line_search_epsilon = 1e-4);
+
+    BatchResult optimize(const BatchProblem& problem, const BatchFunction& func) const;
+
+private:
+    size_t max_iters;
+    double epsilon;
+    double line_search_epsilon;
+};
+
+/**
+ * @brief Random search advancing all problems of a batch in lockstep,
+ * problem k draws from stream k of the seed.
+ *
+ */
+class BatchedRandomSearch {
+public:
+    BatchedRandomSearch(double delta0, double p, size_t max_iters, std::uint64_t seed = 0,
+                        double alpha = 0.9, double min_delta = 1e-2);
+
+    BatchResult optimize(const BatchProblem& problem, const BatchFunction& func) const;
+
+private:
+    double delta0;
+    double p;
+    size_t max_iters;
+    std::uint64_t seed;
+    double alpha;
+    double min_delta;
+};
@@ -0,0 +1,969 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <tuple>
+#include <thread>
+
+#include "batched_solver.hpp"
+#include "distributed_cg.hpp"
+#include "finite_sum.hpp"
+#include "least_squares.hpp"
+#include "optimization_method.hpp"
+#include "perf_counters.hpp"
+#include "separable_function.hpp"
+#include "trace.hpp"
+#include "Vector.hpp"
+
+namespace {
+
+/**
+ * @brief Random symmetric positive definite matrix M^T M + n I.
+ *
+ * @param n
+ * @param gen
+ * @return Mat
+ */
+Mat random_spd_matrix(size_t n, Philox4x32& gen) {
+    Mat M(n, std::vector<double>(n));
+    for (auto& row : M) {
+        gen.fill_uniform(row.data(), n);
+        for (auto& el : row) el -= 0.5;
+    }
+    Mat A(n, std::vector<double>(n));
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            double s = 0;
+            for (size_t k = 0; k < n; ++k) {
+                s += M[k][i] * M[k][j];
+            }
+            A[i][j] = s;
+        }
+        A[i][i] += n;
+    }
+    return A;
+}
+
+double norm(const std::vector<double>& x) {
+    double s = 0;
+    for (auto el : x) s += el * el;
+    return std::sqrt(s);
+}
+
+template <typename F>
+double measure_ms(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/**
+ * @brief Stops after max_iter iterations or when two successive points
+ * are closer than epsilon, the rule of BatchedConjugateGradient.
+ *
+ */
+class IterationOrEpsilonCriterion : public Criterion {
+    IterationCriterion iterations;
+    EpsilonCriterion distance;
+public:
+    IterationOrEpsilonCriterion(size_t max_iter, double epsilon) :
+        iterations(max_iter), distance(epsilon) {}
+
+    bool done(const std::vector<std::vector<double>>& trajectory) const override {
+        return iterations.done(trajectory) || distance.done(trajectory);
+    }
+    std::string get_name() const override {return "Iteration or epsilon criterion";}
+};
+
+void print_row(const std::string& name, const BestParams& params, double ms) {
+    std::cout << std::left << std::setw(28) << name
+              << std::setw(14) << params.minimum_value
+              << std::setw(14) << norm(params.minimum_point)
+              << std::setw(8) << params.iter_number
+              << ms << "\n";
+}
+
+/**
+ * @brief Compares fp64, fp32 storage and mixed precision CG on a dense
+ * quadratic form whose minimum is the origin.
+ *
+ */
+void bench_mixed_precision() {
+    const size_t n = 200;
+    Philox4x32 gen(2024);
+    Mat A = random_spd_matrix(n, gen);
+    auto f64 = std::make_shared<QuadraticForm>(A);
+    auto f32 = std::make_shared<QuadraticFormF32>(A);
+
+    Rectangle area(std::vector<std::pair<double, double>>(n, {-1., 1.}));
+    std::vector<double> x0 = area.sample_random_point(gen);
+    EpsilonCriterion criterion(1e-8);
+
+    std::cout << "\n---- Mixed precision CG, n = " << n << " ----\n";
+    std::cout << std::left << std::setw(28) << "mode" << std::setw(14) << "f(x)"
+              << std::setw(14) << "|x - x*|" << std::setw(8) << "iters" << "ms\n";
+
+    ConjugateGradientMethod cg;
+    cg.set_starting_point(x0);
+    double ms = measure_ms([&]() {cg.optimize(area, *f64, criterion);});
+    print_row("fp64", cg.get_best_params(), ms);
+
+    ms = measure_ms([&]() {cg.optimize(area, *f32, criterion);});
+    BestParams params = cg.get_best_params();
+    params.minimum_value = (*f64)(params.minimum_point);
+    print_row("fp32 storage", params, ms);
+
+    cg.set_mixed_precision(f32, 5);
+    ms = measure_ms([&]() {cg.optimize(area, *f64, criterion);});
+    print_row("fp32 + fp64 refinement", cg.get_best_params(), ms);
+}
+
+/**
+ * @brief Compares nonlinear CG with truncated Newton-CG on an
+ * ill-conditioned tridiagonal quadratic form and on sin(x) + ... + sin(w).
+ *
+ */
+void bench_newton_cg() {
+    const size_t n = 200;
+    Mat A(n, std::vector<double>(n, 0.));
+    for (size_t i = 0; i < n; ++i) {
+        A[i][i] = 1 + 1000. * i / n;
+        if (i) A[i][i - 1] = A[i - 1][i] = 0.5;
+    }
+    QuadraticForm quadratic(A);
+    Rectangle area(std::vector<std::pair<double, double>>(n, {-1., 2.}));
+    std::vector<double> x0(n, 1.);
+    EpsilonCriterion criterion(1e-9);
+
+    std::cout << "\n---- Newton-CG vs CG, ill-conditioned quadratic, n = " << n << " ----\n";
+    std::cout << std::left << std::setw(28) << "method" << std::setw(14) << "f(x)"
+              << std::setw(14) << "|x - x*|" << std::setw(8) << "iters" << "ms\n";
+
+    ConjugateGradientMethod cg;
+    cg.set_starting_point(x0);
+    double ms = measure_ms([&]() {cg.optimize(area, quadratic, criterion);});
+    print_row("nonlinear CG", cg.get_best_params(), ms);
+
+    NewtonConjugateGradient newton;
+    newton.set_starting_point(x0);
+    ms = measure_ms([&]() {newton.optimize(area, quadratic, criterion);});
+    print_row("Newton-CG", newton.get_best_params(), ms);
+
+    Rectangle box(std::vector<std::pair<double, double>>(4, {-3., 3.}));
+    Func4dim1 sines;
+    std::cout << "\n---- Newton-CG vs CG, " << sines.get_name() << " ----\n";
+    cg.set_starting_point({1., 0.5, -0.5, -1.});
+    ms = measure_ms([&]() {cg.optimize(box, sines, criterion);});
+    print_row("nonlinear CG", cg.get_best_params(), ms);
+    newton.set_starting_point({1., 0.5, -0.5, -1.});
+    ms = measure_ms([&]() {newton.optimize(box, sines, criterion);});
+    print_row("Newton-CG", newton.get_best_params(), ms);
+}
+
+/**
+ * @brief Runs CG without preconditioner, with the exact Hessian diagonal
+ * and with the adaptive diagonal on a badly scaled quadratic form
+ * S B S, where B is well conditioned and S spans two orders of magnitude.
+ *
+ */
+void bench_preconditioned_cg() {
+    const size_t n = 100;
+    Philox4x32 gen(31);
+    Mat B = random_spd_matrix(n, gen);
+    std::vector<double> scale(n);
+    for (auto& el : scale) el = std::pow(10., 2 * gen.uniform());
+    Mat A(n, std::vector<double>(n));
+    std::vector<double> hessian_diag(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            A[i][j] = scale[i] * B[i][j] * scale[j];
+        }
+        hessian_diag[i] = 2 * A[i][i];
+    }
+    QuadraticForm func(A);
+    Rectangle area(std::vector<std::pair<double, double>>(n, {-2., 3.}));
+    std::vector<double> x0(n, 1.);
+    // high enough for every mode to converge, iters compares them
+    IterationCriterion criterion(1000);
+
+    std::cout << "\n---- Preconditioned CG, badly scaled quadratic, n = " << n << " ----\n";
+    std::cout << std::left << std::setw(28) << "preconditioner" << std::setw(14) << "f(x)"
+              << std::setw(14) << "|x - x*|" << std::setw(8) << "iters" << "ms\n";
+
+    std::vector<std::pair<std::string, std::shared_ptr<Preconditioner>>> modes = {
+        {"none", nullptr},
+        {"Hessian diagonal", std::make_shared<DiagonalPreconditioner>(hessian_diag)},
+        {"adaptive diagonal", std::make_shared<AdaptiveDiagonalPreconditioner>()}
+    };
+    for (auto& mode : modes) {
+        ConjugateGradientMethod cg;
+        cg.set_starting_point(x0);
+        cg.set_preconditioner(mode.second);
+        double ms = measure_ms([&]() {cg.optimize(area, func, criterion);});
+        print_row(mode.first, cg.get_best_params(), ms);
+    }
+}
+
+/**
+ * @brief Times value and gradient of a dense quadratic form for several
+ * pool sizes and checks that results do not depend on the thread count.
+ *
+ */
+void bench_parallel_quadratic_form() {
+    const size_t n = 2000;
+    const int repeats = 5;
+    Philox4x32 gen(7);
+    Mat A(n, std::vector<double>(n));
+    for (size_t i = 0; i < n; ++i) {
+        gen.fill_uniform(A[i].data(), n);
+    }
+    std::vector<double> x(n);
+    gen.fill_uniform(x.data(), n);
+
+    std::cout << "\n---- Parallel quadratic form, n = " << n << " ----\n";
+    std::cout << std::left << std::setw(10) << "threads" << std::setw(24) << "f(x)"
+              << std::setw(14) << "value ms" << "gradient ms\n";
+
+    QuadraticForm serial(A);
+    double value = 0;
+    std::vector<double> grad;
+    double value_ms = measure_ms([&]() {for (int r = 0; r < repeats; ++r) value = serial(x);});
+    double grad_ms = measure_ms([&]() {for (int r = 0; r < repeats; ++r) grad = serial.get_gradient(x);});
+    std::cout << std::setw(10) << "serial" << std::setw(24) << std::setprecision(17) << value
+              << std::setprecision(6) << std::setw(14) << value_ms / repeats << grad_ms / repeats << "\n";
+
+    double reference = 0;
+    for (size_t threads : {1, 2, 4, 8}) {
+        QuadraticForm parallel(A);
+        parallel.set_thread_pool(std::make_shared<ThreadPool>(threads));
+        value_ms = measure_ms([&]() {for (int r = 0; r < repeats; ++r) value = parallel(x);});
+        grad_ms = measure_ms([&]() {for (int r = 0; r < repeats; ++r) grad = parallel.get_gradient(x);});
+        if (threads == 1) reference = value;
+        std::cout << std::setw(10) << threads << std::setw(24) << std::setprecision(17) << value
+                  << std::setprecision(6) << std::setw(14) << value_ms / repeats << grad_ms / repeats
+                  << (value == reference ? "" : "  (differs from 1 thread!)") << "\n";
+    }
+}
+
+/**
+ * @brief Strong scaling of distributed CG on a tridiagonal SPD system
+ * for both transports.
+ *
+ */
+void bench_distributed_cg() {
+    const size_t n = 200000;
+    // every rank generates only its own rows
+    auto loader = [n](size_t begin, size_t end) {
+        RowBlock block;
+        for (size_t i = begin; i < end; ++i) {
+            std::vector<std::pair<size_t, double>> row;
+            if (i > 0) row.push_back({i - 1, -1.});
+            row.push_back({i, 2.5});
+            if (i + 1 < n) row.push_back({i + 1, -1.});
+            block.A.add_row(row);
+        }
+        block.b.assign(end - begin, 1.);
+        return block;
+    };
+    DistributedConjugateGradient solver(n, loader, 1e-8);
+
+    std::cout << "\n---- Distributed CG, n = " << n << " ----\n";
+    std::cout << std::left << std::setw(16) << "transport" << std::setw(8) << "ranks"
+              << std::setw(24) << "f(x)" << std::setw(8) << "iters" << "ms\n";
+    for (auto kind : {ETransport::SHARED_MEMORY, ETransport::UNIX_SOCKET}) {
+        for (int ranks : {1, 2, 4}) {
+            BestParams params;
+            double ms = measure_ms([&]() {
+                run_distributed(ranks, kind, [&](Transport& transport) {
+                    BestParams res = solver.solve(transport);
+                    if (transport.get_rank() == 0) params = res;
+                });
+            });
+            std::cout << std::setw(16) << (kind == ETransport::SHARED_MEMORY ? "shared memory" : "unix socket")
+                      << std::setw(8) << ranks << std::setw(24) << std::setprecision(17)
+                      << params.minimum_value << std::setprecision(6) << std::setw(8)
+                      << params.iter_number << ms << "\n";
+        }
+    }
+}
+
+/**
+ * @brief Forwards to another function and counts gradient evaluations.
+ * Line restrictions are forwarded only with fast_path.
+ *
+ */
+class GradientCounter : public Function<> {
+    const Function<>& func;
+    bool fast_path;
+    mutable size_t values = 0;
+    mutable size_t gradients = 0;
+public:
+    GradientCounter(const Function<>& func, bool fast_path = false) :
+        Function(func.get_dim()), func(func), fast_path(fast_path) {}
+
+    double operator()(const std::vector<double>& x) const override {
+        ++values;
+        return func(x);
+    }
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override {
+        ++gradients;
+        return func.get_gradient(x);
+    }
+
+    std::shared_ptr<const LineRestriction> restrict_to_line(const std::vector<double>& x,
+                                                            const std::vector<double>& v) const override {
+        return fast_path ? func.restrict_to_line(x, v) : nullptr;
+    }
+
+    std::shared_ptr<Function> create_instance() const override {
+        return std::make_shared<GradientCounter>(*this);
+    }
+
+    std::string get_name() const override {return func.get_name();}
+
+    size_t get_values() const {return values;}
+    size_t get_gradients() const {return gradients;}
+};
+
+/**
+ * @brief Gradient evaluations per outer CG iteration with bisection
+ * over the whole interval and with the adaptive line search.
+ *
+ */
+void bench_line_search() {
+    const size_t n = 200;
+    Philox4x32 gen(7);
+    QuadraticForm quadratic(random_spd_matrix(n, gen));
+    Rectangle cube(std::vector<std::pair<double, double>>(n, {-1., 1.}));
+    Func4dim1 sines;
+    Rectangle box(std::vector<std::pair<double, double>>(4, {-3., 3.}));
+    EpsilonCriterion criterion(1e-8);
+
+    std::cout << "\n---- CG line search ----\n";
+    std::cout << std::left << std::setw(20) << "function" << std::setw(12) << "search"
+              << std::setw(14) << "f(x)" << std::setw(8) << "iters"
+              << std::setw(14) << "grads/iter" << "ms\n";
+    std::vector<std::tuple<std::string, const Function<>*, const Rectangle*, std::vector<double>>> problems = {
+        {"quadratic, n = 200", &quadratic, &cube, cube.sample_random_point(gen)},
+        {"sin sum, n = 4", &sines, &box, {1., 0.5, -0.5, -1.}}
+    };
+    for (auto& problem : problems) {
+        for (ELineSearch kind : {ELineSearch::BISECTION, ELineSearch::ADAPTIVE}) {
+            GradientCounter func(*std::get<1>(problem));
+            ConjugateGradientMethod cg;
+            cg.set_starting_point(std::get<3>(problem));
+            cg.set_line_search(kind);
+            double ms = measure_ms([&]() {cg.optimize(*std::get<2>(problem), func, criterion);});
+            const BestParams& params = cg.get_best_params();
+            std::cout << std::setw(20) << std::get<0>(problem)
+                      << std::setw(12) << (kind == ELineSearch::BISECTION ? "bisection" : "adaptive")
+                      << std::setw(14) << params.minimum_value << std::setw(8) << params.iter_number
+                      << std::setw(14) << static_cast<double>(func.get_gradients()) / params.iter_number
+                      << ms << "\n";
+        }
+    }
+}
+
+/**
+ * @brief Line search probes through AuxiliaryFunction on a dense quadratic
+ * form, with the restrict_to_line fast path and without it (the same
+ * function behind a forwarding wrapper), then whole CG runs both ways.
+ *
+ */
+void bench_line_restriction() {
+    const size_t n = 1000;
+    const size_t probes = 50;
+    Philox4x32 gen(11);
+    auto quadratic = std::make_shared<QuadraticForm>(random_spd_matrix(n, gen));
+    Rectangle cube(std::vector<std::pair<double, double>>(n, {-1., 1.}));
+    std::vector<double> x = cube.sample_random_point(gen);
+    std::vector<double> v = cube.sample_random_point(gen);
+
+    std::cout << "\n---- Line restriction, quadratic form n = " << n << ", " << probes << " probes ----\n";
+    std::cout << std::left << std::setw(16) << "path" << std::setw(20) << "sum of phi'" << "ms\n";
+    std::vector<std::pair<std::string, std::shared_ptr<Function<>>>> paths = {
+        {"full gradient", std::make_shared<GradientCounter>(*quadratic)},
+        {"restriction", quadratic}
+    };
+    for (auto& [name, func] : paths) {
+        double sum = 0;
+        double ms = measure_ms([&]() {
+            AuxiliaryFunction phi(x, v, func);
+            for (size_t k = 0; k < probes; ++k) {
+                sum += phi.get_gradient({static_cast<double>(k) / probes})[0];
+            }
+        });
+        std::cout << std::setw(16) << name << std::setw(20) << std::setprecision(12) << sum
+                  << std::setprecision(6) << ms << "\n";
+    }
+
+    std::cout << std::setw(16) << "CG path" << std::setw(14) << "f(x)" << std::setw(8) << "iters"
+              << std::setw(10) << "grads" << "ms\n";
+    IterationCriterion criterion(50);
+    for (bool fast_path : {false, true}) {
+        GradientCounter func(*quadratic, fast_path);
+        ConjugateGradientMethod cg;
+        cg.set_starting_point(x);
+        cg.set_line_search(ELineSearch::BISECTION);
+        double ms = measure_ms([&]() {cg.optimize(cube, func, criterion);});
+        const BestParams& params = cg.get_best_params();
+        std::cout << std::setw(16) << (fast_path ? "restriction" : "full gradient")
+                  << std::setw(14) << params.minimum_value << std::setw(8) << params.iter_number
+                  << std::setw(10) << func.get_gradients() << ms << "\n";
+    }
+}
+
+/**
+ * @brief Forwards to another function, every gradient additionally
+ * waits for delay as if it came from an expensive simulation.
+ *
+ */
+class SlowGradient : public Function<> {
+    const Function<>& func;
+    std::chrono::microseconds delay;
+public:
+    SlowGradient(const Function<>& func, std::chrono::microseconds delay) :
+        Function(func.get_dim()), func(func), delay(delay) {}
+
+    double operator()(const std::vector<double>& x) const override {return func(x);}
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override {
+        std::this_thread::sleep_for(delay);
+        return func.get_gradient(x);
+    }
+
+    std::shared_ptr<Function> create_instance() const override {
+        return std::make_shared<SlowGradient>(*this);
+    }
+
+    std::string get_name() const override {return func.get_name();}
+};
+
+/**
+ * @brief Bisection against k-section line search with probes evaluated
+ * on a pool, for a function whose gradient takes 200 us.
+ *
+ */
+void bench_k_section() {
+    Func4dim1 sines;
+    SlowGradient func(sines, std::chrono::microseconds(200));
+    Rectangle box(std::vector<std::pair<double, double>>(4, {-3., 3.}));
+    EpsilonCriterion criterion(1e-8);
+
+    std::cout << "\n---- K-section line search, gradient 200 us ----\n";
+    std::cout << std::left << std::setw(16) << "search" << std::setw(14) << "f(x)"
+              << std::setw(8) << "iters" << "ms\n";
+    for (size_t k : {0, 1, 3, 7}) {
+        ConjugateGradientMethod cg;
+        cg.set_starting_point({1., 0.5, -0.5, -1.});
+        std::string name = "bisection";
+        if (k == 0) {
+            cg.set_line_search(ELineSearch::BISECTION);
+        } else {
+            cg.set_k_section(k, std::make_shared<ThreadPool>(k));
+            name = std::to_string(k) + "-section";
+        }
+        double ms = measure_ms([&]() {cg.optimize(box, func, criterion);});
+        const BestParams& params = cg.get_best_params();
+        std::cout << std::setw(16) << name << std::setw(14) << params.minimum_value
+                  << std::setw(8) << params.iter_number << ms << "\n";
+    }
+}
+
+/**
+ * @brief Shifted sphere that remembers after how many evaluations
+ * it first dropped below target.
+ *
+ */
+class TargetCounter : public Function<> {
+    double target;
+    mutable size_t evaluations = 0;
+    mutable size_t hit = 0;
+public:
+    TargetCounter(size_t dim, double target) : Function(dim), target(target) {}
+
+    double operator()(const std::vector<double>& x) const override {
+        double s = 0;
+        for (size_t i = 0; i < dim; ++i) {
+            double d = x[i] - 0.3 - 0.1 * i / dim;
+            s += d * d;
+        }
+        ++evaluations;
+        if (!hit && s < target) hit = evaluations;
+        return s;
+    }
+
+    std::vector<double> get_gradient(const std::vector<double>&) const override {
+        throw std::logic_error("TargetCounter is used without gradients.");
+    }
+
+    std::shared_ptr<Function> create_instance() const override {
+        return std::make_shared<TargetCounter>(*this);
+    }
+
+    std::string get_name() const override {return "Shifted sphere";}
+
+    /// 0 if the target was not reached
+    size_t get_hit() const {return hit;}
+};
+
+/**
+ * @brief Separable sum of sin(x_i) + (x_i - c_i)^2 / 2: generic CG
+ * against CoordinateNewtonMethod, and value plus gradient in two
+ * passes against value_and_gradient.
+ *
+ */
+void bench_separable() {
+    const size_t n = 100000;
+    const int repeats = 20;
+    auto func = make_separable_function(n,
+        [](size_t i, double x) {double d = x - 0.1 * (i % 7); return std::sin(x) + 0.5 * d * d;},
+        [](size_t i, double x) {return std::cos(x) + x - 0.1 * (i % 7);},
+        [](size_t, double x) {return 1 - std::sin(x);},
+        "sum sin(x_i) + (x_i - c_i)^2 / 2");
+    Philox4x32 gen(17);
+    Rectangle cube(std::vector<std::pair<double, double>>(n, {-2., 2.}));
+    std::vector<double> x0 = cube.sample_random_point(gen);
+    EpsilonCriterion criterion(1e-8);
+
+    std::cout << "\n---- Separable function, n = " << n << " ----\n";
+    std::cout << std::left << std::setw(28) << "mode" << std::setw(14) << "f(x)"
+              << std::setw(14) << "|x|" << std::setw(8) << "iters" << "ms\n";
+
+    ConjugateGradientMethod cg;
+    cg.set_starting_point(x0);
+    double ms = measure_ms([&]() {cg.optimize(cube, *func, criterion);});
+    print_row("conjugate gradient", cg.get_best_params(), ms);
+
+    CoordinateNewtonMethod newton;
+    newton.set_starting_point(x0);
+    ms = measure_ms([&]() {newton.optimize(cube, *func, criterion);});
+    print_row("coordinate Newton", newton.get_best_params(), ms);
+
+    func->set_thread_pool(std::make_shared<ThreadPool>(4));
+    ms = measure_ms([&]() {newton.optimize(cube, *func, criterion);});
+    print_row("coordinate Newton 4 thr.", newton.get_best_params(), ms);
+    func->set_thread_pool(nullptr);
+
+    double value = 0;
+    std::vector<double> grad;
+    double separate_ms = measure_ms([&]() {
+        for (int r = 0; r < repeats; ++r) {
+            value = (*func)(x0);
+            grad = func->get_gradient(x0);
+        }
+    });
+    double fused_ms = measure_ms([&]() {
+        for (int r = 0; r < repeats; ++r) value = func->value_and_gradient(x0, grad);
+    });
+    std::cout << "value + gradient ms: separate " << separate_ms / repeats
+              << ", fused " << fused_ms / repeats << "\n";
+}
+
+/**
+ * @brief Least squares over rows streamed from a temporary data file:
+ * full CG on the streamed objective against mini-batch CG, and the
+ * time of one full pass for several pool sizes.
+ *
+ */
+void bench_finite_sum() {
+    const size_t rows = 400000;
+    const size_t cols = 16;
+    const std::string path = (std::filesystem::temp_directory_path() / "optim_finite_sum.bin").string();
+    Philox4x32 gen(19);
+    std::vector<double> w_true(cols);
+    gen.fill_uniform(w_true.data(), cols);
+    {
+        FiniteSumWriter writer(path, cols);
+        std::vector<double> a(cols);
+        for (size_t r = 0; r < rows; ++r) {
+            gen.fill_uniform(a.data(), cols);
+            double b = 0.01 * (gen.uniform() - 0.5);
+            for (size_t j = 0; j < cols; ++j) b += a[j] * w_true[j];
+            writer.add_row(a.data(), b);
+        }
+        writer.close();
+    }
+
+    FiniteSumFunction func(path);
+    Rectangle box(std::vector<std::pair<double, double>>(cols, {-2., 2.}));
+    std::vector<double> x0(cols, 0.);
+
+    std::cout << "\n---- Finite sum least squares, " << rows << " rows x " << cols << " ----\n";
+    std::cout << std::left << std::setw(10) << "threads" << "pass ms\n";
+    std::vector<double> grad;
+    for (size_t threads : {0, 2, 4}) {
+        func.set_thread_pool(threads ? std::make_shared<ThreadPool>(threads) : nullptr);
+        double ms = measure_ms([&]() {grad = func.get_gradient(x0);});
+        std::cout << std::setw(10) << (threads ? std::to_string(threads) : "serial") << ms << "\n";
+    }
+    func.set_thread_pool(nullptr);
+
+    std::cout << std::left << std::setw(28) << "mode" << std::setw(14) << "f(x)"
+              << std::setw(14) << "|x|" << std::setw(8) << "iters" << "ms\n";
+    ConjugateGradientMethod cg;
+    cg.set_starting_point(x0);
+    IterationCriterion criterion(30);
+    double ms = measure_ms([&]() {cg.optimize(box, func, criterion);});
+    print_row("full CG", cg.get_best_params(), ms);
+
+    MiniBatchConjugateGradient minibatch(1000, 5, 1.5);
+    minibatch.set_seed(3);
+    minibatch.set_starting_point(x0);
+    IterationCriterion outer(10);
+    ms = measure_ms([&]() {minibatch.optimize(box, func, outer);});
+    print_row("mini-batch CG", minibatch.get_best_params(), ms);
+    std::filesystem::remove(path);
+}
+
+/**
+ * @brief Tall sparse least squares with badly scaled columns: CGLS and
+ * LSQR with and without damping, and ConjugateGradientMethod on
+ * LeastSquaresFunction. None of them forms A^T A.
+ *
+ */
+void bench_least_squares() {
+    const size_t m = 50000;
+    const size_t n = 500;
+    const size_t per_row = 8;
+    Philox4x32 gen(23);
+    std::vector<double> scales(n);
+    for (size_t j = 0; j < n; ++j) {
+        scales[j] = std::pow(10., -2. * j / n);
+    }
+    CSRMatrix A;
+    A.cols = n;
+    std::vector<double> u(2 * per_row);
+    for (size_t i = 0; i < m; ++i) {
+        gen.fill_uniform(u.data(), u.size());
+        std::vector<std::pair<size_t, double>> entries;
+        for (size_t k = 0; k < per_row; ++k) {
+            size_t j = std::min(static_cast<size_t>(u[k] * n), n - 1);
+            entries.push_back({j, (u[per_row + k] - 0.5) * scales[j]});
+        }
+        std::sort(entries.begin(), entries.end());
+        std::vector<std::pair<size_t, double>> merged;
+        for (auto& entry : entries) {
+            if (!merged.empty() && merged.back().first == entry.first) {
+                merged.back().second += entry.second;
+            } else {
+                merged.push_back(entry);
+            }
+        }
+        A.add_row(merged);
+    }
+    auto op = std::make_shared<SparseOperator>(std::move(A));
+    std::vector<double> x_true(n);
+    gen.fill_uniform(x_true.data(), n);
+    std::vector<double> b;
+    op->apply(x_true, b);
+    for (auto& el : b) el += 1e-3 * (gen.uniform() - 0.5);
+
+    std::cout << "\n---- Sparse least squares, " << m << " x " << n << " ----\n";
+    std::cout << std::left << std::setw(28) << "mode" << std::setw(14) << "f(x)"
+              << std::setw(14) << "|x|" << std::setw(8) << "iters" << "ms\n";
+    BestParams params;
+    double ms = measure_ms([&]() {params = CGLS(0, 1e-8, 5000).solve(*op, b);});
+    print_row("CGLS", params, ms);
+    ms = measure_ms([&]() {params = LSQR(0, 1e-8, 5000).solve(*op, b);});
+    print_row("LSQR", params, ms);
+    ms = measure_ms([&]() {params = CGLS(0.1, 1e-8, 5000).solve(*op, b);});
+    print_row("CGLS, damping 0.1", params, ms);
+    ms = measure_ms([&]() {params = LSQR(0.1, 1e-8, 5000).solve(*op, b);});
+    print_row("LSQR, damping 0.1", params, ms);
+
+    LeastSquaresFunction func(op, b);
+    Rectangle box(std::vector<std::pair<double, double>>(n, {-10., 10.}));
+    ConjugateGradientMethod cg;
+    cg.set_starting_point(std::vector<double>(n, 0.));
+    IterationCriterion criterion(300);
+    ms = measure_ms([&]() {cg.optimize(box, func, criterion);});
+    print_row("CG on LeastSquaresFunction", cg.get_best_params(), ms);
+}
+
+/**
+ * @brief Evaluations random search needs to reach a target value
+ * with uniform and quasi-random sampling of the area.
+ *
+ */
+void bench_samplers() {
+    const size_t runs = 50;
+    const size_t max_iters = 20000;
+
+    std::cout << "\n---- Random search evaluations to target, mean of " << runs << " runs ----\n";
+    std::cout << std::left << std::setw(8) << "dim" << std::setw(12) << "uniform"
+              << std::setw(12) << "sobol" << std::setw(12) << "halton" << "lhs\n";
+    for (size_t dim : {4, 8, 16}) {
+        Rectangle area(std::vector<std::pair<double, double>>(dim, {-1, 1}));
+        const double target = 0.15 * dim;
+        std::cout << std::setw(8) << dim;
+        for (int kind = 0; kind < 4; ++kind) {
+            double total = 0;
+            size_t missed = 0;
+            for (size_t run = 0; run < runs; ++run) {
+                Philox4x32 gen(17, run);
+                std::shared_ptr<Sampler> sampler;
+                if (kind == 1) sampler = std::make_shared<SobolSampler>(dim, gen.split(runs + run));
+                if (kind == 2) sampler = std::make_shared<HaltonSampler>(dim, gen.split(runs + run));
+                if (kind == 3) sampler = std::make_shared<LatinHypercubeSampler>(dim, 256, gen.split(runs + run));
+
+                // p = 0 samples only the whole area, where the sampler matters
+                RandomSearch rs(0.5, 0., max_iters);
+                rs.set_seed(17, run);
+                rs.set_sampler(sampler);
+                TargetCounter func(dim, target);
+                IterationCriterion criterion(max_iters);
+                rs.optimize(area, func, criterion);
+                total += func.get_hit() ? func.get_hit() : max_iters;
+                missed += func.get_hit() == 0;
+            }
+            std::string cell = std::to_string(static_cast<size_t>(total / runs));
+            if (missed) cell += "(" + std::to_string(missed) + "x)";
+            std::cout << std::setw(12) << cell;
+        }
+        std::cout << "\n";
+    }
+}
+
+/**
+ * @brief Many independent Func3dim2 problems over random boxes: scalar
+ * ConjugateGradientMethod loop against the lockstep batched solver.
+ *
+ */
+void bench_batched_cg() {
+    const size_t count = 10000;
+    const size_t dim = 3;
+    Philox4x32 gen(11);
+    BatchProblem problem;
+    problem.lower.assign(dim, std::vector<double>(count));
+    problem.upper.assign(dim, std::vector<double>(count));
+    problem.x0.assign(dim, std::vector<double>(count));
+    for (size_t k = 0; k < count; ++k) {
+        for (size_t i = 0; i < dim; ++i) {
+            double lo = -2 * gen.uniform();
+            double hi = 2 * gen.uniform();
+            problem.lower[i][k] = lo;
+            problem.upper[i][k] = hi;
+            problem.x0[i][k] = lo + (hi - lo) * gen.uniform();
+        }
+    }
+
+    // both sides bisect to 1e-4 and stop after max_iters iterations or
+    // when two successive points are closer than eps
+    const size_t max_iters = 20;
+    const double eps = 1e-6;
+    Func3dim2 func;
+    double scalar_sum = 0;
+    size_t scalar_iters = 0;
+    double scalar_ms = measure_ms([&]() {
+        ConjugateGradientMethod cg;
+        cg.set_line_search(ELineSearch::BISECTION);
+        IterationOrEpsilonCriterion criterion(max_iters, eps);
+        for (size_t k = 0; k < count; ++k) {
+            std::vector<std::pair<double, double>> bounds(dim);
+            std::vector<double> x0(dim);
+            for (size_t i = 0; i < dim; ++i) {
+                bounds[i] = {problem.lower[i][k], problem.upper[i][k]};
+                x0[i] = problem.x0[i][k];
+            }
+            cg.set_starting_point(x0);
+            cg.optimize(Rectangle(bounds), func, criterion);
+            scalar_sum += cg.get_best_params().minimum_value;
+            scalar_iters += cg.get_best_params().iter_number;
+        }
+    });
+
+    BatchResult res;
+    double batched_ms = measure_ms([&]() {
+        res = BatchedConjugateGradient(max_iters, eps).optimize(problem, BatchFunc3dim2());
+    });
+    double batched_sum = 0;
+    size_t batched_iters = 0;
+    for (double v : res.minimum_value) batched_sum += v;
+    for (size_t it : res.iter_number) batched_iters += it;
+
+    std::cout << "\n---- Batched CG, " << count << " problems of Func3dim2 ----\n";
+    std::cout << std::left << std::setw(12) << "mode" << std::setw(20) << "sum of minima"
+              << std::setw(14) << "iterations" << "ms\n";
+    std::cout << std::setw(12) << "scalar" << std::setw(20) << scalar_sum
+              << std::setw(14) << scalar_iters << scalar_ms << "\n";
+    std::cout << std::setw(12) << "batched" << std::setw(20) << batched_sum
+              << std::setw(14) << batched_iters << batched_ms << "\n";
+    std::cout << "speedup " << scalar_ms / batched_ms << "x\n";
+}
+
+/**
+ * @brief Achievable double precision FLOP/s of this build: independent
+ * multiply-add chains that stay in registers.
+ *
+ * @return double
+ */
+double measure_peak_flops() {
+    const size_t chains = 8;
+    const size_t steps = 20000000;
+    double acc[chains];
+    for (size_t i = 0; i < chains; ++i) acc[i] = i;
+    volatile double mul_in = 0.999999, add_in = 1e-7;
+    double mul = mul_in, add = add_in;
+    double ms = measure_ms([&]() {
+        for (size_t k = 0; k < steps; ++k) {
+            for (size_t i = 0; i < chains; ++i) acc[i] = acc[i] * mul + add;
+        }
+    });
+    volatile double sink = 0;
+    for (size_t i = 0; i < chains; ++i) sink = sink + acc[i];
+    return 2. * chains * steps / (ms * 1e-3);
+}
+
+/**
+ * @brief Memory bandwidth in bytes/s of a STREAM triad over arrays much
+ * larger than the last level cache.
+ *
+ * @return double
+ */
+double measure_bandwidth() {
+    const size_t n = size_t(1) << 22;
+    const int repeats = 5;
+    std::vector<double> a(n), b(n, 1.), c(n, 2.);
+    double best_ms = 0;
+    for (int r = 0; r < repeats; ++r) {
+        double ms = measure_ms([&]() {
+            for (size_t i = 0; i < n; ++i) a[i] = b[i] + 3. * c[i];
+        });
+        if (r == 0 || ms < best_ms) best_ms = ms;
+    }
+    volatile double sink = a[n / 2];
+    (void)sink;
+    return 3. * sizeof(double) * n / (best_ms * 1e-3);
+}
+
+/**
+ * @brief Prints a value or n/a when the counter is missing.
+ *
+ * @param value
+ * @param width
+ */
+void print_counter(double value, int width) {
+    if (std::isnan(value)) {
+        std::cout << std::setw(width) << "n/a";
+    } else {
+        std::cout << std::setw(width) << value;
+    }
+}
+
+/**
+ * @brief Hardware counters of the function kernels and of a CG solve:
+ * IPC, bytes moved from memory (last level cache misses * 64) and the
+ * byte count of the kernel model per iteration, GFLOP/s and its share of
+ * the roofline min(peak, arithmetic intensity * bandwidth). Without perf
+ * access only the time based columns are filled.
+ *
+ */
+void bench_roofline() {
+    const size_t line_bytes = 64;
+    double peak = measure_peak_flops();
+    double bandwidth = measure_bandwidth();
+    PerfCounters counters;
+
+    std::cout << "\n---- Roofline ----\n";
+    std::cout << "peak " << peak * 1e-9 << " GFLOP/s, bandwidth " << bandwidth * 1e-9 << " GB/s\n";
+    if (!counters.is_available()) {
+        std::cout << "hardware counters unavailable (" << counters.get_error() << ")\n";
+    }
+    std::cout << std::left << std::setw(22) << "kernel" << std::setw(8) << "iters"
+              << std::setw(8) << "IPC" << std::setw(14) << "LLC B/iter" << std::setw(14) << "model B/iter"
+              << std::setw(14) << "br miss/iter" << std::setw(10) << "GFLOP/s" << "% roofline\n";
+
+    auto report = [&](const std::string& name, double iters, double flops, double bytes,
+        const PerfSample& sample)
+    {
+        double achieved = flops * iters / sample.seconds;
+        double roof = std::min(peak, flops / bytes * bandwidth);
+        std::cout << std::setw(22) << name << std::setw(8) << iters << std::setprecision(3);
+        print_counter(sample.ipc(), 8);
+        print_counter(sample.cache_misses * line_bytes / iters, 14);
+        std::cout << std::setw(14) << bytes;
+        print_counter(sample.branch_misses / iters, 14);
+        std::cout << std::setw(10) << achieved * 1e-9 << 100 * achieved / roof
+                  << std::setprecision(6) << "\n";
+    };
+
+    const size_t n = 2000;
+    const int repeats = 5;
+    Philox4x32 gen(5);
+    Mat A(n, std::vector<double>(n));
+    for (size_t i = 0; i < n; ++i) {
+        gen.fill_uniform(A[i].data(), n);
+        for (size_t j = 0; j < i; ++j) A[i][j] = A[j][i];
+    }
+    std::vector<double> x(n);
+    gen.fill_uniform(x.data(), n);
+
+    // symmetric A, so the gradient 2 A x is one row-wise pass over A
+    double dense_flops = 2. * n * n;
+    QuadraticForm f64(A);
+    std::vector<double> grad;
+    PerfSample sample = counters.measure([&]() {
+        for (int r = 0; r < repeats; ++r) grad = f64.get_gradient(x);
+    });
+    report("dense gradient fp64", repeats, dense_flops, 8. * n * n, sample);
+
+    QuadraticFormF32 f32(A);
+    sample = counters.measure([&]() {
+        for (int r = 0; r < repeats; ++r) grad = f32.get_gradient(x);
+    });
+    report("dense gradient fp32", repeats, dense_flops, 4. * n * n, sample);
+
+    const size_t vector_n = size_t(1) << 20;
+    VectorDouble a(vector_n, 1.), b(vector_n, 2.), c;
+    sample = counters.measure([&]() {
+        for (int r = 0; r < repeats; ++r) c = a + 0.5 * b;
+    });
+    report("VectorDouble a + s*b", repeats, 2. * vector_n, 3. * sizeof(double) * vector_n, sample);
+
+    // a solve per outer iteration, every value and gradient reads A once
+    const size_t cg_n = 1000;
+    QuadraticForm quadratic(random_spd_matrix(cg_n, gen));
+    GradientCounter counted(quadratic);
+    Rectangle cube(std::vector<std::pair<double, double>>(cg_n, {-1., 1.}));
+    ConjugateGradientMethod cg;
+    cg.set_starting_point(cube.sample_random_point(gen));
+    IterationCriterion criterion(20);
+    sample = counters.measure([&]() {cg.optimize(cube, counted, criterion);});
+    double iters = cg.get_best_params().iter_number;
+    double evaluations = (counted.get_values() + counted.get_gradients()) / iters;
+    report("CG solve", iters, evaluations * 2. * cg_n * cg_n,
+        evaluations * 8. * cg_n * cg_n, sample);
+}
+
+}
+
+int main() {
+    // with -DOPTIM_TRACE=ON the solver phases go to this file
+    const char* trace_path = std::getenv("OPTIM_TRACE_FILE");
+    trace_enable(trace_path != nullptr);
+
+    // forks workers, so it runs before any thread pool is created
+    bench_distributed_cg();
+    bench_mixed_precision();
+    bench_newton_cg();
+    bench_preconditioned_cg();
+    bench_line_search();
+    bench_k_section();
+    bench_line_restriction();
+    bench_separable();
+    bench_finite_sum();
+    bench_least_squares();
+    bench_parallel_quadratic_form();
+    bench_batched_cg();
+    bench_samplers();
+    bench_roofline();
+    if (trace_path) trace_write(trace_path);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "cached_function.hpp"
+
+double CachedFunction::Stats::value_hit_rate() const {
+    size_t total = value_hits + value_misses;
+    return total ? static_cast<double>(value_hits) / total : 0.;
+}
+
+double CachedFunction::Stats::gradient_hit_rate() const {
+    size_t total = gradient_hits + gradient_misses;
+    return total ? static_cast<double>(gradient_hits) / total : 0.;
+}
+
+CachedFunction::CachedFunction(std::shared_ptr<const Function<>> func, size_t capacity) :
+    Function(func->get_dim()), func(std::move(func)), state(std::make_shared<State>(capacity)) {}
+
+double CachedFunction::operator()(const std::vector<double>& x) const {
+    auto key = LRUCache<double>::make_key(x);
+    double value;
+    if (state->values.get(key, value)) {
+        ++state->value_hits;
+        return value;
+    }
+    ++state->value_misses;
+    value = (*func)(x);
+    state->values.put(key, value);
+    return value;
+}
+
+std::vector<double> CachedFunction::get_gradient(const std::vector<double>& x) const {
+    auto key = LRUCache<std::vector<double>>::make_key(x);
+    std::vector<double> grad;
+    if (state->gradients.get(key, grad)) {
+        ++state->gradient_hits;
+        return grad;
+    }
+    ++state->gradient_misses;
+    grad = func->get_gradient(x);
+    state->gradients.put(key, grad);
+    return grad;
+}
+
+std::shared_ptr<Function<>> CachedFunction::create_instance() const {
+    return std::make_shared<CachedFunction>(*this);
+}
+
+std::string CachedFunction::get_name() const {
+    return func->get_name();
+}
+
+std::uint64_t CachedFunction::get_version() const {
+    return func->get_version();
+}
+
+CachedFunction::Stats CachedFunction::get_stats() const {
+    return {state->value_hits, state->value_misses,
+            state->gradient_hits, state->gradient_misses};
+}
+
+void CachedFunction::clear() {
+    state->values.clear();
+    state->gradients.clear();
+    state->value_hits = 0;
+    state->value_misses = 0;
+    state->gradient_hits = 0;
+    state->gradient_misses = 0;
+}
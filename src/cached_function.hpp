@@ -0,0 +1,174 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "function.hpp"
+
+/**
+ * @brief Bounded least recently used map from points to values.
+ * Points are compared by their exact bit patterns. Thread safe.
+ *
+ * @tparam V stored value type
+ */
+template <typename V>
+class LRUCache {
+public:
+    using Key = std::vector<std::uint64_t>;
+
+    LRUCache(size_t capacity) : capacity(capacity) {}
+
+    static Key make_key(const std::vector<double>& x);
+
+    /**
+     * @brief Looks up the key and marks it as recently used.
+     *
+     * @param key
+     * @param value receives cached value on hit
+     * @return true, if key was found
+     * @return false, otherwise
+     */
+    bool get(const Key& key, V& value);
+
+    void put(const Key& key, V value);
+
+    void clear();
+
+    size_t size() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    using Entry = std::pair<Key, V>;
+
+    size_t capacity;
+    std::list<Entry> entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, KeyHash> index;
+    mutable std::mutex mutex;
+};
+
+/**
+ * @brief Decorator that memoizes values and gradients of another function.
+ * Copies made by create_instance share the same caches and statistics.
+ *
+ */
+class CachedFunction : public Function<> {
+public:
+    struct Stats {
+        size_t value_hits;
+        size_t value_misses;
+        size_t gradient_hits;
+        size_t gradient_misses;
+
+        double value_hit_rate() const;
+        double gradient_hit_rate() const;
+    };
+
+    /**
+     * @brief Construct a new Cached Function object
+     *
+     * @param func wrapped function, function_view(f) wraps f without owning it
+     * @param capacity maximum number of points kept in each cache
+     */
+    CachedFunction(std::shared_ptr<const Function<>> func, size_t capacity = 1024);
+
+    double operator()(const std::vector<double>& x) const override;
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override;
+
+    std::shared_ptr<Function> create_instance() const override;
+
+    std::string get_name() const override;
+    std::uint64_t get_version() const override;
+
+    Stats get_stats() const;
+
+    /**
+     * @brief Drops cached points and resets statistics.
+     *
+     */
+    void clear();
+
+private:
+    struct State {
+        State(size_t capacity) : values(capacity), gradients(capacity) {}
+
+        LRUCache<double> values;
+        LRUCache<std::vector<double>> gradients;
+        std::atomic<size_t> value_hits{0};
+        std::atomic<size_t> value_misses{0};
+        std::atomic<size_t> gradient_hits{0};
+        std::atomic<size_t> gradient_misses{0};
+    };
+
+    std::shared_ptr<const Function<>> func;
+    std::shared_ptr<State> state;
+};
+
+
+template <typename V>
+typename LRUCache<V>::Key LRUCache<V>::make_key(const std::vector<double>& x) {
+    Key key(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        std::memcpy(&key[i], &x[i], sizeof(double));
+    }
+    return key;
+}
+
+template <typename V>
+size_t LRUCache<V>::KeyHash::operator()(const Key& key) const {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (auto bits : key) {
+        h ^= bits;
+        h *= 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    return static_cast<size_t>(h);
+}
+
+template <typename V>
+bool LRUCache<V>::get(const Key& key, V& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) return false;
+    entries.splice(entries.begin(), entries, it->second);
+    value = it->second->second;
+    return true;
+}
+
+template <typename V>
+void LRUCache<V>::put(const Key& key, V value) {
+    if (capacity == 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->second = std::move(value);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    if (entries.size() >= capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    entries.emplace_front(key, std::move(value));
+    index[key] = entries.begin();
+}
+
+template <typename V>
+void LRUCache<V>::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    index.clear();
+    entries.clear();
+}
+
+template <typename V>
+size_t LRUCache<V>::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
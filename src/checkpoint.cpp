@@ -0,0 +1,189 @@
+#include "checkpoint.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+void BinaryWriter::write_u64(std::uint64_t value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+}
+
+void BinaryWriter::write_double(double value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+}
+
+void BinaryWriter::write_vector(const std::vector<double>& vec) {
+    write_u64(vec.size());
+    const char* bytes = reinterpret_cast<const char*>(vec.data());
+    buffer.insert(buffer.end(), bytes, bytes + vec.size() * sizeof(double));
+}
+
+void BinaryWriter::write_matrix(const std::vector<std::vector<double>>& mat) {
+    write_u64(mat.size());
+    for (auto& row : mat) {
+        write_vector(row);
+    }
+}
+
+void BinaryWriter::write_string(const std::string& str) {
+    write_u64(str.size());
+    buffer.insert(buffer.end(), str.begin(), str.end());
+}
+
+
+BinaryReader BinaryReader::from_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Can not open checkpoint " + path);
+    return BinaryReader(std::vector<char>(std::istreambuf_iterator<char>(in), {}));
+}
+
+void BinaryReader::read_raw(void* data, size_t bytes) {
+    if (buffer.size() - pos < bytes) {
+        throw std::runtime_error("Binary data is truncated.");
+    }
+    std::memcpy(data, buffer.data() + pos, bytes);
+    pos += bytes;
+}
+
+std::uint64_t BinaryReader::read_u64() {
+    std::uint64_t value;
+    read_raw(&value, sizeof(value));
+    return value;
+}
+
+double BinaryReader::read_double() {
+    double value;
+    read_raw(&value, sizeof(value));
+    return value;
+}
+
+std::vector<double> BinaryReader::read_vector() {
+    std::uint64_t size = read_u64();
+    if ((buffer.size() - pos) / sizeof(double) < size) {
+        throw std::runtime_error("Binary data is truncated.");
+    }
+    std::vector<double> vec(size);
+    read_raw(vec.data(), size * sizeof(double));
+    return vec;
+}
+
+std::vector<std::vector<double>> BinaryReader::read_matrix() {
+    std::uint64_t rows = read_u64();
+    std::vector<std::vector<double>> mat;
+    for (std::uint64_t i = 0; i < rows; ++i) {
+        mat.push_back(read_vector());
+    }
+    return mat;
+}
+
+std::string BinaryReader::read_string() {
+    std::uint64_t size = read_u64();
+    if (buffer.size() - pos < size) {
+        throw std::runtime_error("Binary data is truncated.");
+    }
+    std::string str(buffer.data() + pos, size);
+    pos += size;
+    return str;
+}
+
+
+namespace {
+
+const std::uint64_t CHECKPOINT_MAGIC = 0x54504b434d4743; // "CGMCKPT"
+const std::uint64_t CHECKPOINT_VERSION = 4;
+
+}
+
+void write_checkpoint_header(BinaryWriter& out, ECheckpoint kind) {
+    out.write_u64(CHECKPOINT_MAGIC);
+    out.write_u64(CHECKPOINT_VERSION);
+    out.write_u64(static_cast<std::uint64_t>(kind));
+}
+
+void read_checkpoint_header(BinaryReader& in, ECheckpoint kind) {
+    if (in.read_u64() != CHECKPOINT_MAGIC) {
+        throw std::invalid_argument("File is not a checkpoint.");
+    }
+    if (in.read_u64() != CHECKPOINT_VERSION) {
+        throw std::invalid_argument("Unsupported checkpoint version.");
+    }
+    if (in.read_u64() != static_cast<std::uint64_t>(kind)) {
+        throw std::invalid_argument("Checkpoint was written by another method.");
+    }
+}
+
+
+CheckpointWriter::CheckpointWriter(std::string path) :
+    path(std::move(path)), worker(&CheckpointWriter::worker_loop, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+void CheckpointWriter::submit(std::vector<char> data) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = std::move(data);
+        has_pending = true;
+    }
+    cv.notify_all();
+}
+
+void CheckpointWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() {return !has_pending && !writing;});
+}
+
+void CheckpointWriter::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this]() {return stop || has_pending;});
+        if (!has_pending) return;
+        std::vector<char> data = std::move(pending);
+        has_pending = false;
+        writing = true;
+        lock.unlock();
+        try {
+            write_file(data);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+        }
+        lock.lock();
+        writing = false;
+        cv.notify_all();
+    }
+}
+
+void CheckpointWriter::write_file(const std::vector<char>& data) const {
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Can not write checkpoint " + tmp);
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            close(fd);
+            throw std::runtime_error("Can not write checkpoint " + tmp);
+        }
+        written += n;
+    }
+    fsync(fd);
+    close(fd);
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Can not rename checkpoint to " + path);
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * @brief Appends plain little endian values to a byte buffer.
+ *
+ */
+class BinaryWriter {
+    std::vector<char> buffer;
+
+public:
+    void write_u64(std::uint64_t value);
+    void write_double(double value);
+    void write_vector(const std::vector<double>& vec);
+    void write_matrix(const std::vector<std::vector<double>>& mat);
+    void write_string(const std::string& str);
+
+    std::vector<char>& get_buffer() {return buffer;}
+};
+
+/**
+ * @brief Reads values written by BinaryWriter, throws on truncated data.
+ *
+ */
+class BinaryReader {
+    std::vector<char> buffer;
+    size_t pos = 0;
+
+public:
+    BinaryReader(std::vector<char> buffer) : buffer(std::move(buffer)) {}
+
+    /**
+     * @brief Reads the whole file.
+     *
+     * @param path
+     * @return BinaryReader
+     */
+    static BinaryReader from_file(const std::string& path);
+
+    std::uint64_t read_u64();
+    double read_double();
+    std::vector<double> read_vector();
+    std::vector<std::vector<double>> read_matrix();
+    std::string read_string();
+
+private:
+    void read_raw(void* data, size_t bytes);
+};
+
+/**
+ * @brief Kind of stepper stored in a checkpoint.
+ *
+ */
+enum class ECheckpoint : std::uint64_t {
+    CONJUGATE_GRADIENT = 1,
+    RANDOM_SEARCH = 2
+};
+
+/**
+ * @brief Writes file magic, format version and kind.
+ *
+ * @param out
+ * @param kind
+ */
+void write_checkpoint_header(BinaryWriter& out, ECheckpoint kind);
+
+/**
+ * @brief Checks file magic, format version and kind.
+ * Throws std::invalid_argument if the checkpoint is of another kind.
+ *
+ * @param in
+ * @param kind expected kind
+ */
+void read_checkpoint_header(BinaryReader& in, ECheckpoint kind);
+
+/**
+ * @brief Writes checkpoints on a background thread. Each file is written
+ * to path.tmp and renamed over path, so path always holds a complete
+ * checkpoint. If the solver is faster than the disk only the newest
+ * pending checkpoint is written.
+ *
+ */
+class CheckpointWriter {
+public:
+    CheckpointWriter(std::string path);
+
+    /**
+     * @brief Writes the pending checkpoint and stops the thread.
+     *
+     */
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void submit(std::vector<char> data);
+
+    /**
+     * @brief Blocks until every submitted checkpoint is on disk.
+     *
+     */
+    void flush();
+
+    const std::string& get_path() const {return path;}
+
+private:
+    std::string path;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<char> pending;
+    bool has_pending = false;
+    bool writing = false;
+    bool stop = false;
+    std::thread worker;
+
+    void worker_loop();
+    void write_file(const std::vector<char>& data) const;
+};
@@ -0,0 +1,209 @@
+#include "distributed_cg.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+size_t distributed_block_begin(size_t n, int rank, int size) {
+    return n * rank / size;
+}
+
+namespace {
+
+/**
+ * @brief Swaps buffers with peer. Lower rank sends first, so the
+ * pairwise exchanges of all ranks can not deadlock.
+ *
+ */
+void exchange(Transport& transport, int peer, const void* send_data, size_t send_bytes,
+              void* recv_data, size_t recv_bytes)
+{
+    if (transport.get_rank() < peer) {
+        if (send_bytes) transport.send(peer, send_data, send_bytes);
+        if (recv_bytes) transport.recv(peer, recv_data, recv_bytes);
+    } else {
+        if (recv_bytes) transport.recv(peer, recv_data, recv_bytes);
+        if (send_bytes) transport.send(peer, send_data, send_bytes);
+    }
+}
+
+/**
+ * @brief Rows of A owned by one rank with columns renumbered:
+ * owned entries first, then halo entries grouped by owner rank.
+ *
+ */
+struct LocalPart {
+    size_t begin;
+    size_t end;
+    CSRMatrix A;
+    /// halo entries received from rank r start at halo_offset[r]
+    std::vector<size_t> halo_offset;
+    std::vector<size_t> halo_count;
+    /// local indices of owned entries rank r needs from us
+    std::vector<std::vector<size_t>> send_index;
+
+    size_t local_size() const {return end - begin;}
+};
+
+/**
+ * @brief Renumbers the columns of the rows [begin, end), given in block
+ * with global column indices, and agrees on halo lists with the peers.
+ *
+ */
+LocalPart make_local_part(Transport& transport, size_t n, size_t begin, size_t end, CSRMatrix block) {
+    int rank = transport.get_rank();
+    int size = transport.get_size();
+
+    LocalPart part;
+    part.begin = begin;
+    part.end = end;
+
+    std::vector<size_t> bounds(size + 1);
+    for (int r = 0; r <= size; ++r) bounds[r] = distributed_block_begin(n, r, size);
+
+    std::vector<std::vector<size_t>> needed(size);
+    for (size_t c : block.col) {
+        if (c >= part.begin && c < part.end) continue;
+        int owner = static_cast<int>(std::upper_bound(bounds.begin(), bounds.end(), c) - bounds.begin()) - 1;
+        needed[owner].push_back(c);
+    }
+
+    part.halo_offset.assign(size, 0);
+    part.halo_count.assign(size, 0);
+    size_t offset = part.local_size();
+    for (int r = 0; r < size; ++r) {
+        std::sort(needed[r].begin(), needed[r].end());
+        needed[r].erase(std::unique(needed[r].begin(), needed[r].end()), needed[r].end());
+        part.halo_offset[r] = offset;
+        part.halo_count[r] = needed[r].size();
+        offset += needed[r].size();
+    }
+
+    part.send_index.assign(size, {});
+    for (int peer = 0; peer < size; ++peer) {
+        if (peer == rank) continue;
+        std::uint64_t my_count = needed[peer].size(), peer_count = 0;
+        exchange(transport, peer, &my_count, sizeof(my_count), &peer_count, sizeof(peer_count));
+        std::vector<std::uint64_t> mine(needed[peer].begin(), needed[peer].end());
+        std::vector<std::uint64_t> theirs(peer_count);
+        exchange(transport, peer, mine.data(), mine.size() * sizeof(std::uint64_t),
+                 theirs.data(), theirs.size() * sizeof(std::uint64_t));
+        for (auto idx : theirs) {
+            part.send_index[peer].push_back(idx - part.begin);
+        }
+    }
+
+    // renumbered in place, the block is not needed afterwards
+    for (auto& c : block.col) {
+        if (c >= part.begin && c < part.end) {
+            c -= part.begin;
+        } else {
+            int owner = static_cast<int>(std::upper_bound(bounds.begin(), bounds.end(), c) - bounds.begin()) - 1;
+            auto it = std::lower_bound(needed[owner].begin(), needed[owner].end(), c);
+            c = part.halo_offset[owner] + (it - needed[owner].begin());
+        }
+    }
+    block.cols = offset;
+    part.A = std::move(block);
+    return part;
+}
+
+/**
+ * @brief y = A x for the owned rows, x holds owned entries and room
+ * for the halo which is filled here.
+ *
+ */
+void multiply(Transport& transport, const LocalPart& part, std::vector<double>& x,
+              std::vector<double>& y)
+{
+    std::vector<double> send_buf;
+    for (int peer = 0; peer < transport.get_size(); ++peer) {
+        if (peer == transport.get_rank()) continue;
+        send_buf.clear();
+        for (size_t idx : part.send_index[peer]) {
+            send_buf.push_back(x[idx]);
+        }
+        exchange(transport, peer, send_buf.data(), send_buf.size() * sizeof(double),
+                 x.data() + part.halo_offset[peer], part.halo_count[peer] * sizeof(double));
+    }
+    part.A.multiply(x.data(), y.data(), 0, part.local_size());
+}
+
+double local_dot(const std::vector<double>& a, const std::vector<double>& b, size_t n) {
+    double res = 0;
+    for (size_t i = 0; i < n; ++i) {
+        res += a[i] * b[i];
+    }
+    return res;
+}
+
+}
+
+DistributedConjugateGradient::DistributedConjugateGradient(
+    size_t n, RowBlockLoader loader, double tolerance, size_t max_iters
+) : dim(n), loader(std::move(loader)), tolerance(tolerance), max_iters(max_iters) {}
+
+BestParams DistributedConjugateGradient::solve(Transport& transport) const {
+    size_t begin = distributed_block_begin(dim, transport.get_rank(), transport.get_size());
+    size_t end = distributed_block_begin(dim, transport.get_rank() + 1, transport.get_size());
+    RowBlock block = loader(begin, end);
+    if (block.A.rows != end - begin ||
+        !(block.b.empty() || block.b.size() == end - begin) ||
+        !(block.x0.empty() || block.x0.size() == end - begin))
+    {
+        throw std::invalid_argument("Row block has incompatible dimentions.");
+    }
+    for (size_t c : block.A.col) {
+        if (c >= dim) throw std::invalid_argument("Row block has a column out of range.");
+    }
+    std::vector<double> b = std::move(block.b);
+    if (b.empty()) b.assign(end - begin, 0.);
+    LocalPart part = make_local_part(transport, dim, begin, end, std::move(block.A));
+    size_t n = part.local_size();
+    size_t ext = part.A.cols;
+
+    // vectors multiplied by A are kept with room for the halo
+    std::vector<double> x(ext), p(ext), r(n), q(n);
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = block.x0.empty() ? 0. : block.x0[i];
+    }
+
+    // gradient of f is 2 A x - b, so CG solves 2 A x = b
+    multiply(transport, part, x, q);
+    for (size_t i = 0; i < n; ++i) {
+        r[i] = b[i] - 2 * q[i];
+        p[i] = r[i];
+    }
+    double rr = transport.allreduce_sum(local_dot(r, r, n));
+
+    size_t iter = 0;
+    while (iter < max_iters && std::sqrt(rr) >= tolerance) {
+        multiply(transport, part, p, q);
+        for (size_t i = 0; i < n; ++i) q[i] *= 2;
+        double alpha = rr / transport.allreduce_sum(local_dot(p, q, n));
+        for (size_t i = 0; i < n; ++i) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+        }
+        double rr_new = transport.allreduce_sum(local_dot(r, r, n));
+        double beta = rr_new / rr;
+        for (size_t i = 0; i < n; ++i) {
+            p[i] = r[i] + beta * p[i];
+        }
+        rr = rr_new;
+        ++iter;
+    }
+
+    multiply(transport, part, x, q);
+    double local_value = 0;
+    for (size_t i = 0; i < n; ++i) {
+        local_value += x[i] * q[i] - b[i] * x[i];
+    }
+
+    BestParams params{};
+    params.minimum_value = transport.allreduce_sum(local_value);
+    params.minimum_point.assign(x.begin(), x.begin() + n);
+    params.iter_number = iter;
+    return params;
+}
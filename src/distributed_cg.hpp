@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include "sparse_matrix.hpp"
+#include "stepper.hpp"
+#include "transport.hpp"
+
+/**
+ * @brief Rows [begin, end) of the system owned by one rank.
+ *
+ */
+struct RowBlock {
+    /// end - begin rows with global column indices
+    CSRMatrix A;
+    /// entries [begin, end) of the linear term, zero if empty
+    std::vector<double> b;
+    /// entries [begin, end) of the starting point, zero if empty
+    std::vector<double> x0;
+};
+
+/**
+ * @brief Builds the rows [begin, end) of a rank, e.g. by reading them
+ * from a file or generating them.
+ *
+ */
+using RowBlockLoader = std::function<RowBlock(size_t begin, size_t end)>;
+
+/**
+ * @brief First row of rank's block when n rows are split between size ranks.
+ *
+ * @param n
+ * @param rank
+ * @param size
+ * @return size_t
+ */
+size_t distributed_block_begin(size_t n, int rank, int size);
+
+/**
+ * @brief Linear conjugate gradient for f(x) = x^T A x - b^T x with
+ * symmetric positive definite sparse A, distributed over the ranks of
+ * a Transport. Rows of A and entries of all vectors are split into
+ * contiguous blocks (see distributed_block_begin). Every rank loads only
+ * its own block, so no process holds all of A, b or x. Dot products use
+ * allreduce and the sparse matrix-vector product exchanges only the
+ * halo entries each rank reads. The problem is unconstrained.
+ *
+ */
+class DistributedConjugateGradient {
+public:
+    /**
+     * @brief Construct a new Distributed Conjugate Gradient object
+     *
+     * @param n number of rows and columns of A
+     * @param loader called by solve on every rank for the rank's rows,
+     * A must be symmetric positive definite
+     * @param tolerance stop when |grad f| < tolerance
+     * @param max_iters
+     */
+    DistributedConjugateGradient(size_t n, RowBlockLoader loader,
+                                 double tolerance = 1e-10, size_t max_iters = 1000);
+
+    /**
+     * @brief Must be called on every rank. Throws std::invalid_argument
+     * if the loaded block does not match its rows.
+     *
+     * @param transport
+     * @return BestParams minimum_point holds only the rows of this rank,
+     * Transport::allgather joins the blocks if the full point is needed
+     */
+    BestParams solve(Transport& transport) const;
+
+private:
+    size_t dim;
+    RowBlockLoader loader;
+    double tolerance;
+    size_t max_iters;
+};
@@ -0,0 +1,345 @@
+#include "finite_sum.hpp"
+
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+namespace {
+
+const std::uint64_t DATA_MAGIC = 0x4d55534554494e46; // "FINITSUM"
+const std::uint64_t DATA_VERSION = 1;
+
+struct DataHeader {
+    std::uint64_t magic;
+    std::uint64_t version;
+    std::uint64_t rows;
+    std::uint64_t cols;
+};
+
+/**
+ * @brief Adds the loss of one row at w to value and its gradient to grad.
+ *
+ */
+void add_row_loss(const double* row, size_t cols, ELoss loss, const std::vector<double>& w,
+                  double& value, double* grad)
+{
+    double z = 0;
+    for (size_t j = 0; j < cols; ++j) {
+        z += row[j] * w[j];
+    }
+    double target = row[cols];
+    double slope;
+    if (loss == ELoss::LEAST_SQUARES) {
+        double r = z - target;
+        value += 0.5 * r * r;
+        slope = r;
+    } else {
+        // log(1 + exp(t)) without overflow for large t
+        double t = -target * z;
+        value += t > 0 ? t + std::log1p(std::exp(-t)) : std::log1p(std::exp(t));
+        slope = -target / (1 + std::exp(-t));
+    }
+    if (!grad) return;
+    for (size_t j = 0; j < cols; ++j) {
+        grad[j] += slope * row[j];
+    }
+}
+
+/**
+ * @brief Objective over a fixed list of rows, evaluated serially.
+ *
+ */
+class FiniteSumBatch : public Function<> {
+    std::shared_ptr<const FiniteSumData> data;
+    ELoss loss;
+    std::vector<size_t> rows;
+
+    double evaluate(const std::vector<double>& w, std::vector<double>* grad) const {
+        size_t cols = data->get_cols();
+        double value = 0;
+        if (grad) grad->assign(cols, 0);
+        for (size_t r : rows) {
+            add_row_loss(data->row(r), cols, loss, w, value, grad ? grad->data() : nullptr);
+        }
+        if (grad) {
+            for (auto& el : *grad) el /= rows.size();
+        }
+        return value / rows.size();
+    }
+
+public:
+    FiniteSumBatch(std::shared_ptr<const FiniteSumData> data, ELoss loss, std::vector<size_t> rows) :
+        Function(data->get_cols()), data(std::move(data)), loss(loss), rows(std::move(rows)) {}
+
+    double operator()(const std::vector<double>& w) const override {
+        return evaluate(w, nullptr);
+    }
+
+    std::vector<double> get_gradient(const std::vector<double>& w) const override {
+        std::vector<double> grad;
+        evaluate(w, &grad);
+        return grad;
+    }
+
+    std::shared_ptr<Function> create_instance() const override {
+        return std::make_shared<FiniteSumBatch>(*this);
+    }
+
+    std::string get_name() const override {return "Finite sum mini-batch";}
+};
+
+}
+
+FiniteSumWriter::FiniteSumWriter(const std::string& path, size_t cols) :
+    file(std::fopen(path.c_str(), "wb")), cols(cols)
+{
+    if (!file) {
+        throw std::runtime_error("Can not create " + path + ": " + std::strerror(errno));
+    }
+    // row count is patched by close
+    DataHeader header{DATA_MAGIC, DATA_VERSION, 0, cols};
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::fclose(file);
+        throw std::runtime_error("Can not write " + path);
+    }
+}
+
+FiniteSumWriter::~FiniteSumWriter() {
+    if (!file) return;
+    try {
+        close();
+    } catch (...) {}
+}
+
+void FiniteSumWriter::add_row(const double* features, double target) {
+    if (!file) {
+        throw std::logic_error("Row added after close.");
+    }
+    if (std::fwrite(features, sizeof(double), cols, file) != cols ||
+        std::fwrite(&target, sizeof(double), 1, file) != 1)
+    {
+        throw std::runtime_error("Can not write finite sum row.");
+    }
+    ++rows;
+}
+
+void FiniteSumWriter::close() {
+    if (!file) return;
+    DataHeader header{DATA_MAGIC, DATA_VERSION, rows, cols};
+    bool ok = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok) {
+        throw std::runtime_error("Can not finish finite sum file.");
+    }
+}
+
+FiniteSumData::FiniteSumData(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Can not open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    DataHeader header;
+    if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != DATA_MAGIC || header.version != DATA_VERSION || header.cols == 0 ||
+        static_cast<std::uint64_t>(st.st_size) !=
+            sizeof(header) + header.rows * (header.cols + 1) * sizeof(double))
+    {
+        close(fd);
+        throw std::invalid_argument("File " + path + " is not a finite sum data file.");
+    }
+    void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file alive
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("Can not map " + path);
+    }
+    mapping = ptr;
+    mapped_bytes = st.st_size;
+    values = reinterpret_cast<const double*>(static_cast<const char*>(ptr) + sizeof(header));
+    rows = header.rows;
+    cols = header.cols;
+}
+
+FiniteSumData::~FiniteSumData() {
+    munmap(mapping, mapped_bytes);
+}
+
+void FiniteSumData::prefetch(size_t begin, size_t end) const {
+    if (begin >= end) return;
+    static const std::uintptr_t page = sysconf(_SC_PAGESIZE);
+    auto first = reinterpret_cast<std::uintptr_t>(row(begin)) & ~(page - 1);
+    auto last = reinterpret_cast<std::uintptr_t>(row(end));
+    madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED);
+}
+
+FiniteSumFunction::FiniteSumFunction(const std::string& path, ELoss loss, size_t chunk_rows) :
+    FiniteSumFunction(std::make_shared<const FiniteSumData>(path), loss, chunk_rows) {}
+
+FiniteSumFunction::FiniteSumFunction(std::shared_ptr<const FiniteSumData> data, ELoss loss,
+                                     size_t chunk_rows) :
+    Function(data->get_cols()), data(std::move(data)), loss(loss), chunk_rows(chunk_rows)
+{
+    if (this->data->get_rows() == 0) {
+        throw std::invalid_argument("Finite sum has no rows.");
+    }
+    if (chunk_rows == 0) {
+        throw std::invalid_argument("Chunk must hold at least one row.");
+    }
+}
+
+double FiniteSumFunction::evaluate(const std::vector<double>& w, std::vector<double>* grad) const {
+    OPTIM_TRACE_SCOPE("finite sum pass");
+    size_t rows = data->get_rows();
+    size_t cols = data->get_cols();
+    size_t chunks = (rows + chunk_rows - 1) / chunk_rows;
+
+    struct Partial {
+        size_t first_chunk;
+        double value;
+        std::vector<double> grad;
+    };
+    std::mutex mutex;
+    std::vector<Partial> partials;
+    auto body = [&](size_t begin, size_t end) {
+        Partial partial{begin, 0, std::vector<double>(grad ? cols : 0)};
+        data->prefetch(begin * chunk_rows, std::min(rows, (begin + 1) * chunk_rows));
+        for (size_t c = begin; c < end; ++c) {
+            size_t first = c * chunk_rows;
+            size_t last = std::min(rows, first + chunk_rows);
+            // the kernel reads the next chunk while this one is summed
+            if (c + 1 < end) data->prefetch(last, std::min(rows, last + chunk_rows));
+            for (size_t r = first; r < last; ++r) {
+                add_row_loss(data->row(r), cols, loss, w, partial.value,
+                             grad ? partial.grad.data() : nullptr);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        partials.push_back(std::move(partial));
+    };
+    if (pool) {
+        pool->parallel_for(chunks, body);
+    } else {
+        body(0, chunks);
+    }
+
+    // fixed order of partial sums for a given split
+    std::sort(partials.begin(), partials.end(), [](const Partial& a, const Partial& b) {
+        return a.first_chunk < b.first_chunk;
+    });
+    double value = 0;
+    if (grad) grad->assign(cols, 0);
+    for (const auto& partial : partials) {
+        value += partial.value;
+        if (!grad) continue;
+        for (size_t j = 0; j < cols; ++j) {
+            (*grad)[j] += partial.grad[j];
+        }
+    }
+    if (grad) {
+        for (auto& el : *grad) el /= rows;
+    }
+    return value / rows;
+}
+
+double FiniteSumFunction::operator()(const std::vector<double>& w) const {
+    return evaluate(w, nullptr);
+}
+
+std::vector<double> FiniteSumFunction::get_gradient(const std::vector<double>& w) const {
+    std::vector<double> grad;
+    evaluate(w, &grad);
+    return grad;
+}
+
+std::shared_ptr<Function<>> FiniteSumFunction::sample_batch(size_t batch_size, Philox4x32& gen) const {
+    if (batch_size == 0) {
+        throw std::invalid_argument("Mini-batch must hold at least one row.");
+    }
+    std::vector<double> uniform(batch_size);
+    gen.fill_uniform(uniform.data(), batch_size);
+    std::vector<size_t> rows(batch_size);
+    for (size_t i = 0; i < batch_size; ++i) {
+        rows[i] = std::min(static_cast<size_t>(uniform[i] * data->get_rows()), data->get_rows() - 1);
+    }
+    std::sort(rows.begin(), rows.end());
+    return std::make_shared<FiniteSumBatch>(data, loss, std::move(rows));
+}
+
+std::shared_ptr<Function<>> FiniteSumFunction::create_instance() const {
+    return std::make_shared<FiniteSumFunction>(*this);
+}
+
+std::string FiniteSumFunction::get_name() const {
+    return loss == ELoss::LEAST_SQUARES ? "Finite sum least squares" : "Finite sum logistic loss";
+}
+
+
+MiniBatchConjugateGradient::MiniBatchConjugateGradient(size_t batch_size, size_t inner_iters, double growth) :
+    batch_size(batch_size), inner_iters(inner_iters), growth(growth)
+{
+    if (batch_size == 0 || inner_iters == 0 || growth < 1) {
+        throw std::invalid_argument("Mini-batch CG needs positive batch size and iterations and growth >= 1.");
+    }
+}
+
+std::vector<double> MiniBatchConjugateGradient::optimize(
+    const Rectangle& area,
+    const Function<>& func,
+    const Criterion& criterion
+)
+{
+    OPTIM_TRACE_SCOPE("MiniBatchConjugateGradient::optimize");
+    if (!((starting_point.empty() || starting_point.size() == func.get_dim()) && func.get_dim() == area.get_dim())) {
+        throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
+    }
+    auto finite_sum = dynamic_cast<const FiniteSumFunction*>(&func);
+    if (!finite_sum) {
+        throw std::invalid_argument(get_name() + " needs a FiniteSumFunction.");
+    }
+
+    std::vector<double> x = starting_point.empty() ? area.sample_random_point(gen) : starting_point;
+    std::vector<std::vector<double>> trajectory;
+    bool cancelled = false;
+    double size = batch_size;
+    size_t rows = finite_sum->get_data()->get_rows();
+    ConjugateGradientMethod cg;
+    IterationCriterion inner(inner_iters);
+    while (!criterion.done(trajectory)) {
+        if (cancel_token.is_cancelled()) {
+            cancelled = true;
+            break;
+        }
+        auto batch = finite_sum->sample_batch(static_cast<size_t>(size), gen);
+        cg.set_starting_point(x);
+        x = cg.optimize(area, *batch, inner);
+        trajectory.push_back(x);
+        if (progress) {
+            progress->try_push({trajectory.size(), cg.get_best_params().minimum_value, std::nan("")});
+        }
+        size = std::min(size * growth, static_cast<double>(rows));
+    }
+    best_params.minimum_point = x;
+    best_params.minimum_value = func(x);
+    best_params.iter_number = trajectory.size();
+    best_params.cancelled = cancelled;
+    return x;
+}
+
+std::unique_ptr<OptimizationStepper> MiniBatchConjugateGradient::create_stepper(
+    const Rectangle&,
+    const Criterion&
+)
+{
+    throw std::logic_error(get_name() + " draws batches from the function and has no stepper.");
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+
+#include "function.hpp"
+#include "optimization_method.hpp"
+#include "rng.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * Finite-sum objectives f(w) = 1/m sum_r loss(a_r^T w, b_r) over data
+ * rows (a_r, b_r) kept in a binary file:
+ * u64 magic, u64 version, u64 rows, u64 cols, then rows of cols
+ * features followed by the target, all doubles in native byte order.
+ */
+
+enum class ELoss {
+    /// (a^T w - b)^2 / 2
+    LEAST_SQUARES,
+    /// log(1 + exp(-b a^T w)), targets are -1 or 1
+    LOGISTIC
+};
+
+/**
+ * @brief Appends rows to a data file without keeping them in memory.
+ * The header is completed by close.
+ *
+ */
+class FiniteSumWriter {
+public:
+    /**
+     * @brief Creates or truncates path. Throws std::runtime_error on failure.
+     *
+     * @param path
+     * @param cols number of features
+     */
+    FiniteSumWriter(const std::string& path, size_t cols);
+
+    /**
+     * @brief Closes the file if close was not called, errors are ignored.
+     *
+     */
+    ~FiniteSumWriter();
+
+    FiniteSumWriter(const FiniteSumWriter&) = delete;
+    FiniteSumWriter& operator=(const FiniteSumWriter&) = delete;
+
+    /**
+     * @brief Appends one row.
+     *
+     * @param features cols values
+     * @param target
+     */
+    void add_row(const double* features, double target);
+
+    /**
+     * @brief Writes the row count and closes the file.
+     * Throws std::runtime_error on failure.
+     *
+     */
+    void close();
+
+private:
+    std::FILE* file;
+    size_t cols;
+    std::uint64_t rows = 0;
+};
+
+/**
+ * @brief Read-only mapping of a data file, shared by functions over it.
+ *
+ */
+class FiniteSumData {
+public:
+    /**
+     * @brief Maps path. Throws std::runtime_error if it can not be
+     * opened and std::invalid_argument if it is not a data file.
+     *
+     * @param path
+     */
+    FiniteSumData(const std::string& path);
+    ~FiniteSumData();
+
+    FiniteSumData(const FiniteSumData&) = delete;
+    FiniteSumData& operator=(const FiniteSumData&) = delete;
+
+    size_t get_rows() const {return rows;}
+    size_t get_cols() const {return cols;}
+
+    /**
+     * @brief Features of row r followed by its target.
+     *
+     * @param r
+     * @return const double*
+     */
+    const double* row(size_t r) const {return values + r * (cols + 1);}
+
+    /**
+     * @brief Asks the kernel to read rows [begin, end) ahead.
+     *
+     * @param begin
+     * @param end
+     */
+    void prefetch(size_t begin, size_t end) const;
+
+private:
+    void* mapping = nullptr;
+    size_t mapped_bytes = 0;
+    const double* values = nullptr;
+    size_t rows = 0;
+    size_t cols = 0;
+};
+
+/**
+ * @brief Finite-sum objective over all rows of a data file. Every
+ * evaluation streams the mapped file once: rows are split into chunks,
+ * workers of the pool take contiguous runs of chunks and ask the kernel
+ * to read their next chunk while summing the current one, so the data
+ * never has to fit in memory. Copies share the mapping.
+ *
+ */
+class FiniteSumFunction : public Function<> {
+public:
+    /**
+     * @brief Construct a new Finite Sum Function object
+     *
+     * @param path data file
+     * @param loss
+     * @param chunk_rows rows per chunk
+     */
+    FiniteSumFunction(const std::string& path, ELoss loss = ELoss::LEAST_SQUARES,
+                      size_t chunk_rows = 4096);
+
+    FiniteSumFunction(std::shared_ptr<const FiniteSumData> data, ELoss loss = ELoss::LEAST_SQUARES,
+                      size_t chunk_rows = 4096);
+
+    /**
+     * @brief Sums chunks on pool. Results are the same for a given
+     * number of threads, but may differ by rounding between thread counts.
+     *
+     * @param pool nullptr restores serial evaluation
+     */
+    void set_thread_pool(std::shared_ptr<ThreadPool> pool) {this->pool = std::move(pool);}
+
+    double operator()(const std::vector<double>& w) const override;
+
+    std::vector<double> get_gradient(const std::vector<double>& w) const override;
+
+    /**
+     * @brief Objective over rows drawn uniformly with replacement,
+     * sorted so that the batch is read in file order.
+     *
+     * @param batch_size
+     * @param gen
+     * @return std::shared_ptr<Function<>> shares the mapping
+     */
+    std::shared_ptr<Function<>> sample_batch(size_t batch_size, Philox4x32& gen) const;
+
+    const std::shared_ptr<const FiniteSumData>& get_data() const {return data;}
+    ELoss get_loss() const {return loss;}
+
+    std::shared_ptr<Function> create_instance() const override;
+
+    std::string get_name() const override;
+
+private:
+    std::shared_ptr<const FiniteSumData> data;
+    ELoss loss;
+    size_t chunk_rows;
+    std::shared_ptr<ThreadPool> pool;
+
+    double evaluate(const std::vector<double>& w, std::vector<double>* grad) const;
+};
+
+/**
+ * @brief Stochastic variant of ConjugateGradientMethod for
+ * FiniteSumFunction: every outer iteration draws a mini-batch and runs
+ * a few CG iterations on it, starting from the last point. The
+ * criterion sees the outer iterations, the best value is the full
+ * objective at the last point.
+ *
+ */
+class MiniBatchConjugateGradient : public OptimizationMethod<> {
+public:
+    /**
+     * @brief Construct a new Mini Batch Conjugate Gradient object
+     *
+     * @param batch_size rows per batch
+     * @param inner_iters CG iterations per batch
+     * @param growth factor applied to batch_size after every batch,
+     * values above 1 reduce the noise as the method converges
+     */
+    MiniBatchConjugateGradient(size_t batch_size, size_t inner_iters = 5, double growth = 1);
+
+    /**
+     * @brief Throws std::invalid_argument if func is not a FiniteSumFunction.
+     *
+     */
+    std::vector<double> optimize(const Rectangle& area, const Function<>& func,
+        const Criterion& criterion) override;
+
+    /**
+     * @brief Not supported: batches are drawn from the function, which
+     * a stepper never sees. Throws std::logic_error.
+     *
+     */
+    std::unique_ptr<OptimizationStepper> create_stepper(const Rectangle& area,
+        const Criterion& criterion) override;
+
+    std::string get_name() const override {
+        return "Mini-batch conjugate gradient method";
+    }
+
+private:
+    size_t batch_size;
+    size_t inner_iters;
+    double growth;
+};
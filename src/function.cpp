@@ -1,5 +1,17 @@
 #include "function.hpp"
 
+namespace {
+
+double dot_product(const std::vector<double>& a, const std::vector<double>& b) {
+    double s = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        s += a[i] * b[i];
+    }
+    return s;
+}
+
+}
+
 LinearFunction::LinearFunction(std::vector<double> coeffs) :
     Function(coeffs.size()),
     coeffs(std::move(coeffs)) {} 
@@ -16,14 +28,83 @@ std::vector<double> LinearFunction::get_gradient(const std::vector<double>& x) c
     return coeffs;
 }
 
+void LinearFunction::hessian_vector_product(const std::vector<double>& x, const std::vector<double>&,
+                                            std::vector<double>& out) const {
+    out.assign(x.size(), 0);
+}
+
+std::shared_ptr<const LineRestriction> LinearFunction::restrict_to_line(const std::vector<double>& x,
+                                                                        const std::vector<double>& v) const {
+    return std::make_shared<PolynomialRestriction>((*this)(x), dot_product(coeffs, v), 0);
+}
+
 std::shared_ptr<Function<>> LinearFunction::create_instance() const {
     return std::make_shared<LinearFunction>(*this);
 }
 
 
-QuadraticForm::QuadraticForm(Mat A) : Function(A.size()), A(A) {};
+namespace {
+
+template <typename S>
+std::shared_ptr<const BasicMat<S>> convert_matrix(const Mat& A) {
+    auto converted = std::make_shared<BasicMat<S>>();
+    converted->reserve(A.size());
+    for (auto& row : A) {
+        converted->emplace_back(row.begin(), row.end());
+    }
+    return converted;
+}
+
+}
+
+template <typename S>
+BasicQuadraticForm<S>::BasicQuadraticForm(const Mat& A) : BasicQuadraticForm(convert_matrix<S>(A)) {}
+
+template <typename S>
+BasicQuadraticForm<S>::BasicQuadraticForm(std::shared_ptr<const BasicMat<S>> A) :
+    Function(A->size()), A(std::move(A)), symmetric(true)
+{
+    const BasicMat<S>& a = *this->A;
+    for (size_t i = 0; i < a.size() && symmetric; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (a[i][j] != a[j][i]) {
+                symmetric = false;
+                break;
+            }
+        }
+    }
+}
+
+template <typename S>
+void BasicQuadraticForm<S>::set_thread_pool(std::shared_ptr<ThreadPool> pool) {
+    this->pool = std::move(pool);
+    if (!this->pool) return;
+    auto local = std::make_shared<BasicMat<S>>(A->size());
+    this->pool->parallel_for(A->size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            (*local)[i] = (*A)[i];
+        }
+    });
+    A = std::move(local);
+}
+
+template <typename S>
+double BasicQuadraticForm<S>::operator()(const std::vector<double>& x) const {
+    const BasicMat<S>& A = *this->A;
+    if (pool) {
+        return deterministic_sum(pool.get(), A.size(), [&](size_t begin, size_t end) {
+            double result = 0;
+            for (size_t i = begin; i < end; ++i) {
+                double tmp = 0;
+                for (size_t j = 0; j < x.size(); ++j) {
+                    tmp += x[j] * A[i][j];
+                }
+                result += x[i] * tmp;
+            }
+            return result;
+        });
+    }
 
-double QuadraticForm::operator()(const std::vector<double>& x) const {
     double result = 0;
     for (int i = 0; i < A.size(); ++i) {
         double tmp = 0;
@@ -35,26 +116,122 @@ double QuadraticForm::operator()(const std::vector<double>& x) const {
     return result;
 }
 
-std::vector<double> QuadraticForm::get_gradient(const std::vector<double>& x) const {
+template <typename S>
+std::vector<double> BasicQuadraticForm<S>::get_gradient(const std::vector<double>& x) const {
+    const BasicMat<S>& A = *this->A;
     std::vector<double> result(A.size());
-    for (int i = 0; i < A.size(); ++i) {
-        for (int j = 0; j < x.size(); ++j) {
-            result[i] += x[j] * (A[i][j] + A[j][i]);
+    auto rows = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (symmetric) {
+                // A_ij + A_ji = 2 A_ij, row access and bitwise the same sum
+                for (size_t j = 0; j < x.size(); ++j) {
+                    result[i] += x[j] * A[i][j];
+                }
+                result[i] *= 2;
+            } else {
+                for (size_t j = 0; j < x.size(); ++j) {
+                    result[i] += x[j] * (static_cast<double>(A[i][j]) + A[j][i]);
+                }
+            }
         }
+    };
+    if (pool) {
+        pool->parallel_for(A.size(), rows);
+    } else {
+        rows(0, A.size());
+    }
+    return result;
+}
+
+template <typename S>
+void BasicQuadraticForm<S>::hessian_vector_product(const std::vector<double>&, const std::vector<double>& v,
+                                                   std::vector<double>& out) const {
+    // gradient (A + A^T) x is linear, so the Hessian product is the gradient at v
+    out = get_gradient(v);
+}
+
+template <typename S>
+std::shared_ptr<const LineRestriction> BasicQuadraticForm<S>::restrict_to_line(
+    const std::vector<double>& x, const std::vector<double>& v) const
+{
+    // (x + av)^T A (x + av) = x^T A x + a x^T (A + A^T) v + a^2 v^T A v
+    return std::make_shared<PolynomialRestriction>((*this)(x), dot_product(get_gradient(x), v), (*this)(v));
+}
+
+
+template <typename S>
+std::shared_ptr<Function<>> BasicQuadraticForm<S>::create_instance() const  {
+    return std::make_shared<BasicQuadraticForm>(*this);
+}
+
+template <>
+std::string BasicQuadraticForm<double>::get_name() const {
+    return "Arbitrary quadratic form";
+}
+
+template <>
+std::string BasicQuadraticForm<float>::get_name() const {
+    return "Arbitrary quadratic form (fp32 storage)";
+}
+
+template class BasicQuadraticForm<double>;
+template class BasicQuadraticForm<float>;
+
+
+SparseQuadraticForm::SparseQuadraticForm(CSRMatrix A) :
+    SparseQuadraticForm(std::make_shared<const CSRMatrix>(std::move(A))) {}
+
+SparseQuadraticForm::SparseQuadraticForm(std::shared_ptr<const CSRMatrix> A) :
+    Function(A->rows), A(std::move(A))
+{
+    if (this->A->rows != this->A->cols) {
+        throw std::invalid_argument("Quadratic form matrix must be square.");
+    }
+}
+
+double SparseQuadraticForm::operator()(const std::vector<double>& x) const {
+    std::vector<double> ax = A->multiply(x);
+    double result = 0;
+    for (size_t i = 0; i < ax.size(); ++i) {
+        result += x[i] * ax[i];
+    }
+    return result;
+}
+
+std::vector<double> SparseQuadraticForm::get_gradient(const std::vector<double>& x) const {
+    std::vector<double> result = A->multiply(x);
+    std::vector<double> atx = A->multiply_transposed(x);
+    for (size_t i = 0; i < result.size(); ++i) {
+        result[i] += atx[i];
     }
     return result;
 }
 
+void SparseQuadraticForm::hessian_vector_product(const std::vector<double>&, const std::vector<double>& v,
+                                                 std::vector<double>& out) const {
+    out = get_gradient(v);
+}
+
+std::shared_ptr<const LineRestriction> SparseQuadraticForm::restrict_to_line(
+    const std::vector<double>& x, const std::vector<double>& v) const
+{
+    return std::make_shared<PolynomialRestriction>((*this)(x), dot_product(get_gradient(x), v), (*this)(v));
+}
 
-std::shared_ptr<Function<>> QuadraticForm::create_instance() const  {
-    return std::make_shared<QuadraticForm>(*this);
+std::shared_ptr<Function<>> SparseQuadraticForm::create_instance() const {
+    return std::make_shared<SparseQuadraticForm>(*this);
 }
 
 
-AuxiliaryFunction::AuxiliaryFunction(std::vector<double> x, std::vector<double> v, const std::shared_ptr<Function<>>& func) :
-    Function(1), x(std::move(x)), v(std::move(v)), func(func) {}
+AuxiliaryFunction::AuxiliaryFunction(std::vector<double> x, std::vector<double> v, std::shared_ptr<const Function<>> func) :
+    Function(1), x(std::move(x)), v(std::move(v)), func(std::move(func)),
+    restriction(this->func->restrict_to_line(this->x, this->v)) {}
+
+AuxiliaryFunction::AuxiliaryFunction(std::vector<double> x, std::vector<double> v, const Function<>& func) :
+    AuxiliaryFunction(std::move(x), std::move(v), function_view(func)) {}
 
 double AuxiliaryFunction::operator()(const std::vector<double>& alpha) const  {
+    if (restriction) return restriction->value(alpha[0]);
     std::vector<double> res;
     res.reserve(x.size());
     for (size_t i = 0; i < x.size(); ++i) {
@@ -64,6 +241,7 @@ double AuxiliaryFunction::operator()(const std::vector<double>& alpha) const  {
 }
 
 std::vector<double> AuxiliaryFunction::get_gradient(const std::vector<double>& alpha) const {
+    if (restriction) return {restriction->derivative(alpha[0])};
     std::vector<double> point;
     point.reserve(x.size());
     for (size_t i = 0; i < x.size(); ++i) {
@@ -78,9 +256,27 @@ std::vector<double> AuxiliaryFunction::get_gradient(const std::vector<double>& a
     return std::vector<double>({res});
 };
 
+void AuxiliaryFunction::hessian_vector_product(const std::vector<double>& alpha,
+                                               const std::vector<double>& dir,
+                                               std::vector<double>& out) const {
+    std::vector<double> point;
+    point.reserve(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        point.push_back(x[i] + alpha[0]* v[i]);
+    }
+    std::vector<double> hv;
+    func->hessian_vector_product(point, v, hv);
+    double res = 0;
+    for (size_t i = 0; i < hv.size(); ++i) {
+        res += hv[i] * v[i];
+    }
+    out = {res * dir[0]};
+}
+
 void AuxiliaryFunction::set_vectors(std::vector<double> x0, std::vector<double> v0) {
     x = std::move(x0);
     v = std::move(v0);
+    restriction = func->restrict_to_line(x, v);
 }
 
 std::shared_ptr<Function<>> AuxiliaryFunction::create_instance() const {
@@ -98,6 +294,11 @@ std::vector<double> Func4::get_gradient(const std::vector<double>& x) const {
     return std::vector<double>({std::cos(x[0])});
 }
 
+void Func4::hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                   std::vector<double>& out) const {
+    out = {-std::sin(x[0]) * v[0]};
+}
+
 std::shared_ptr<Function<>> Func4::create_instance() const {
     return std::make_shared<Func4>(*this);
 }
@@ -112,6 +313,11 @@ std::vector<double> Poly1::get_gradient(const std::vector<double>& x) const {
     return std::vector<double>({3 * x[0]*x[0] - 7 * x[0] - 1});
 }
 
+void Poly1::hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                   std::vector<double>& out) const {
+    out = {(6 * x[0] - 7) * v[0]};
+}
+
 std::shared_ptr<Function<>> Poly1::create_instance() const {
     return std::make_shared<Poly1>(*this);
 }
@@ -126,6 +332,11 @@ std::vector<double> RavineFunction::get_gradient(const std::vector<double>& x) c
     return {8 * x[0], 0};
 }
 
+void RavineFunction::hessian_vector_product(const std::vector<double>&, const std::vector<double>& v,
+                                            std::vector<double>& out) const {
+    out = {8 * v[0], 0};
+}
+
 std::shared_ptr<Function<>> RavineFunction::create_instance() const {
     return std::make_shared<RavineFunction>(*this);
 }
@@ -140,6 +351,11 @@ std::vector<double> Func3dim1::get_gradient(const std::vector<double>& x) const
     return {std::cos(x[0]), std::cos(x[1]), std::cos(x[2])};
 }
 
+void Func3dim1::hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                       std::vector<double>& out) const {
+    out = {-std::sin(x[0]) * v[0], -std::sin(x[1]) * v[1], -std::sin(x[2]) * v[2]};
+}
+
 std::shared_ptr<Function<>> Func3dim1::create_instance() const {
     return std::make_shared<Func3dim1>(*this);
 }
@@ -154,6 +370,11 @@ std::vector<double> Func3dim2::get_gradient(const std::vector<double>& x) const
     return {2 * x[0] - 1, 2 * x[1] + 1, 2 * x[2]};
 }
 
+void Func3dim2::hessian_vector_product(const std::vector<double>&, const std::vector<double>& v,
+                                       std::vector<double>& out) const {
+    out = {2 * v[0], 2 * v[1], 2 * v[2]};
+}
+
 std::shared_ptr<Function<>> Func3dim2::create_instance() const {
     return std::make_shared<Func3dim2>(*this);
 }
@@ -168,6 +389,11 @@ std::vector<double> Func4dim2::get_gradient(const std::vector<double>& x) const
     return {2 * x[0] - 1, 2 * x[1] + 1, 2 * x[2], 2 * x[3] - 0.4};
 }
 
+void Func4dim2::hessian_vector_product(const std::vector<double>&, const std::vector<double>& v,
+                                       std::vector<double>& out) const {
+    out = {2 * v[0], 2 * v[1], 2 * v[2], 2 * v[3]};
+}
+
 std::shared_ptr<Function<>> Func4dim2::create_instance() const {
     return std::make_shared<Func4dim2>(*this);
 }
@@ -182,6 +408,11 @@ std::vector<double> Func4dim1::get_gradient(const std::vector<double>& x) const
     return {std::cos(x[0]), std::cos(x[1]), std::cos(x[2]), std::cos(x[3])};
 }
 
+void Func4dim1::hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                       std::vector<double>& out) const {
+    out = {-std::sin(x[0]) * v[0], -std::sin(x[1]) * v[1], -std::sin(x[2]) * v[2], -std::sin(x[3]) * v[3]};
+}
+
 std::shared_ptr<Function<>> Func4dim1::create_instance() const {
     return std::make_shared<Func4dim1>(*this);
 }
@@ -218,8 +449,8 @@ std::string Func3::get_name() const {
     return "sin(x) + cos(y)";
 }
 
-std::string QuadraticForm::get_name() const {
-    return "Arbitrary quadratic form";
+std::string SparseQuadraticForm::get_name() const {
+    return "Arbitrary sparse quadratic form";
 }
 
 std::string AuxiliaryFunction::get_name() const {
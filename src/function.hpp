@@ -6,6 +6,46 @@
 #include <iostream>
 #include <cmath>
 #include <string>
+#include <cstdint>
+
+#include "sparse_matrix.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * @brief Function restricted to the line x + alpha v, phi(alpha).
+ * 
+ */
+class LineRestriction {
+public:
+    virtual ~LineRestriction() = default;
+
+    virtual double value(double alpha) const = 0;
+
+    /**
+     * @brief phi'(alpha), the directional derivative along v.
+     * 
+     * @param alpha 
+     * @return double 
+     */
+    virtual double derivative(double alpha) const = 0;
+};
+
+/**
+ * @brief phi(alpha) = c0 + c1 alpha + c2 alpha^2, the exact restriction
+ * of linear and quadratic functions.
+ * 
+ */
+class PolynomialRestriction : public LineRestriction {
+    double c0;
+    double c1;
+    double c2;
+public:
+    PolynomialRestriction(double c0, double c1, double c2) : c0(c0), c1(c1), c2(c2) {}
+
+    double value(double alpha) const override {return c0 + alpha * (c1 + alpha * c2);}
+
+    double derivative(double alpha) const override {return c1 + 2 * c2 * alpha;}
+};
 
 /**
  * @brief Base class for all functions
@@ -23,6 +63,32 @@ public:
     virtual size_t get_dim() const {return dim;};
     virtual double operator()(const T& x) const = 0;
     virtual T get_gradient(const T& x) const = 0;
+
+    /**
+     * @brief Product of the Hessian at x with v. The default is
+     * a forward difference of gradients and costs two gradients.
+     * 
+     * @param x 
+     * @param v 
+     * @param out resized to the dimention of x
+     */
+    virtual void hessian_vector_product(const T& x, const T& v, T& out) const;
+
+    /**
+     * @brief Optional fast path for line searches: precomputes whatever
+     * depends only on x and v, so that each probe along the line is
+     * cheaper than a full evaluation. Results may differ from direct
+     * evaluation by rounding.
+     * 
+     * @param x 
+     * @param v 
+     * @return std::shared_ptr<const LineRestriction> nullptr if the
+     * function has no fast path
+     */
+    virtual std::shared_ptr<const LineRestriction> restrict_to_line(const T&, const T&) const {
+        return nullptr;
+    }
+
     /**
      * @brief Creates shared_ptr of current object to base class
      * 
@@ -30,8 +96,54 @@ public:
      */
     virtual std::shared_ptr<Function> create_instance() const = 0;
     virtual std::string get_name() const = 0;
+
+    /**
+     * @brief Version of the implementation. Bump it when values change,
+     * so results cached for the old version (see ResultCache) are recomputed.
+     * 
+     * @return std::uint64_t 
+     */
+    virtual std::uint64_t get_version() const {return 0;}
 };
 
+template <typename T>
+void Function<T>::hessian_vector_product(const T& x, const T& v, T& out) const {
+    double norm_x = 0;
+    double norm_v = 0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        norm_x += x[i] * x[i];
+        norm_v += v[i] * v[i];
+    }
+    out.assign(x.size(), 0);
+    if (norm_v == 0) return;
+    // sqrt of machine epsilon balances truncation and rounding errors
+    double h = 1.4901161193847656e-08 * (1 + std::sqrt(norm_x)) / std::sqrt(norm_v);
+    T shifted = x;
+    for (size_t i = 0; i < x.size(); ++i) {
+        shifted[i] += h * v[i];
+    }
+    T grad_shifted = get_gradient(shifted);
+    T grad = get_gradient(x);
+    for (size_t i = 0; i < x.size(); ++i) {
+        out[i] = (grad_shifted[i] - grad[i]) / h;
+    }
+}
+
+/**
+ * @brief Non-owning pointer to func for decorators such as
+ * AuxiliaryFunction or CachedFunction. Allocates nothing and does no
+ * reference counting, func must outlive every copy of the pointer.
+ * 
+ * @tparam T 
+ * @param func 
+ * @return std::shared_ptr<const Function<T>> 
+ */
+template <typename T>
+std::shared_ptr<const Function<T>> function_view(const Function<T>& func) {
+    // aliasing constructor with an empty owner
+    return std::shared_ptr<const Function<T>>(std::shared_ptr<void>(), &func);
+}
+
 class LinearFunction : public Function<> {
 private:
     std::vector<double> coeffs;
@@ -42,6 +154,12 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
+    std::shared_ptr<const LineRestriction> restrict_to_line(const std::vector<double>& x,
+                                                            const std::vector<double>& v) const override;
+
     std::shared_ptr<Function> create_instance() const override;
     std::string get_name() const override;
 };
@@ -58,6 +176,11 @@ public:
         return std::vector<double>({x[1] - 1, x[0] + 1});
     }
 
+    void hessian_vector_product(const std::vector<double>&, const std::vector<double>& v,
+                                std::vector<double>& out) const override {
+        out = {v[1], v[0]};
+    }
+
     std::shared_ptr<Function> create_instance() const override {
         return std::make_shared<Func1>(*this);
     }
@@ -77,6 +200,13 @@ public:
         return std::vector<double>({std::cos(x[0]) * std::cos(x[1]), -std::sin(x[0]) * std::sin(x[1])});
     }
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override {
+        double dxx = -std::sin(x[0]) * std::cos(x[1]);
+        double dxy = -std::cos(x[0]) * std::sin(x[1]);
+        out = {dxx * v[0] + dxy * v[1], dxy * v[0] + dxx * v[1]};
+    }
+
     std::shared_ptr<Function> create_instance() const override {
         return std::make_shared<Func2>(*this);
     }
@@ -97,6 +227,11 @@ public:
         return std::vector<double>({std::cos(x[0]), - std::sin(x[1])});
     }
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override {
+        out = {-std::sin(x[0]) * v[0], -std::cos(x[1]) * v[1]};
+    }
+
     std::shared_ptr<Function> create_instance() const override {
         return std::make_shared<Func3>(*this);
     }
@@ -104,37 +239,143 @@ public:
     std::string get_name() const override;
 };
 
-using Mat = std::vector<std::vector<double>>;
+template <typename S>
+using BasicMat = std::vector<std::vector<S>>;
+
+using Mat = BasicMat<double>;
 
-class QuadraticForm : public Function<> {
+/**
+ * @brief Quadratic form x^T A x. Matrix is stored with scalar S,
+ * products are always accumulated in double, so float storage halves
+ * memory traffic at the cost of rounding A to single precision.
+ * The matrix is immutable and shared by copies, so create_instance
+ * costs O(1).
+ * 
+ * @tparam S storage type of matrix elements
+ */
+template <typename S = double>
+class BasicQuadraticForm : public Function<> {
 private:
-    Mat A;
+    std::shared_ptr<const BasicMat<S>> A;
+    bool symmetric;
+    std::shared_ptr<ThreadPool> pool;
 
 public:
-    QuadraticForm(Mat A);
+    BasicQuadraticForm(const Mat& A);
+
+    /**
+     * @brief Shares A with other forms without copying.
+     * 
+     * @param A square, must not change while shared
+     */
+    BasicQuadraticForm(std::shared_ptr<const BasicMat<S>> A);
+
+    const std::shared_ptr<const BasicMat<S>>& get_matrix() const {return A;}
+
+    /**
+     * @brief Splits rows between pool workers for value and gradient.
+     * Rows are copied by the worker that owns them, so on NUMA
+     * machines their pages end up on that worker's node. The form
+     * then stops sharing its matrix.
+     * 
+     * @param pool nullptr restores serial evaluation
+     */
+    void set_thread_pool(std::shared_ptr<ThreadPool> pool);
     
     double operator()(const std::vector<double>& x) const override;
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
+
+    /**
+     * @brief Exact quadratic in alpha: three products with A per line,
+     * O(1) per probe.
+     * 
+     */
+    std::shared_ptr<const LineRestriction> restrict_to_line(const std::vector<double>& x,
+                                                            const std::vector<double>& v) const override;
+
+    std::shared_ptr<Function> create_instance() const override;
+
+    std::string get_name() const override;
+};
+
+template <>
+std::string BasicQuadraticForm<double>::get_name() const;
+template <>
+std::string BasicQuadraticForm<float>::get_name() const;
+
+extern template class BasicQuadraticForm<double>;
+extern template class BasicQuadraticForm<float>;
+
+using QuadraticForm = BasicQuadraticForm<double>;
+using QuadraticFormF32 = BasicQuadraticForm<float>;
+
+/**
+ * @brief Quadratic form x^T A x with sparse A. The matrix is immutable
+ * and shared by copies.
+ * 
+ */
+class SparseQuadraticForm : public Function<> {
+private:
+    std::shared_ptr<const CSRMatrix> A;
+
+public:
+    SparseQuadraticForm(CSRMatrix A);
+    SparseQuadraticForm(std::shared_ptr<const CSRMatrix> A);
+
+    double operator()(const std::vector<double>& x) const override;
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override;
+
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
+    /**
+     * @brief Exact quadratic in alpha: three products with A per line,
+     * O(1) per probe.
+     * 
+     */
+    std::shared_ptr<const LineRestriction> restrict_to_line(const std::vector<double>& x,
+                                                            const std::vector<double>& v) const override;
 
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
+
+    const CSRMatrix& get_matrix() const {return *A;}
 };
 
+/**
+ * @brief func restricted to the line x + alpha v as a function of alpha.
+ * Uses func->restrict_to_line when func provides it.
+ * 
+ */
 class AuxiliaryFunction : public Function<> {
     std::vector<double> x;
     std::vector<double> v;
-    std::shared_ptr<Function<>> func;    
+    std::shared_ptr<const Function<>> func;    
+    std::shared_ptr<const LineRestriction> restriction;
 
 public:
-    AuxiliaryFunction(std::vector<double> x, std::vector<double> v, const std::shared_ptr<Function<>>& func);
+    AuxiliaryFunction(std::vector<double> x, std::vector<double> v, std::shared_ptr<const Function<>> func);
+
+    /**
+     * @brief Non-owning view of func, which must outlive the object.
+     * 
+     */
+    AuxiliaryFunction(std::vector<double> x, std::vector<double> v, const Function<>& func);
 
     double operator()(const std::vector<double>& alpha) const override;
 
     std::vector<double> get_gradient(const std::vector<double>& alpha) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     void set_vectors(std::vector<double> x0, std::vector<double> v0);
 
     std::shared_ptr<Function> create_instance() const override;
@@ -151,6 +392,9 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
@@ -163,6 +407,9 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
@@ -175,6 +422,9 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
@@ -187,6 +437,9 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
@@ -199,6 +452,9 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
@@ -211,6 +467,9 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
@@ -223,6 +482,9 @@ public:
 
     std::vector<double> get_gradient(const std::vector<double>& x) const override;
 
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
     std::shared_ptr<Function> create_instance() const override;
 
     std::string get_name() const override;
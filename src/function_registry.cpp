@@ -0,0 +1,202 @@
+#include "function_registry.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "plugin.hpp"
+
+namespace fs = std::filesystem;
+
+void FunctionRegistry::add(const std::string& name, Factory factory) {
+    factories[name] = std::move(factory);
+}
+
+std::shared_ptr<Function<>> FunctionRegistry::create(const std::string& name) const {
+    auto it = factories.find(name);
+    if (it == factories.end()) {
+        throw std::invalid_argument("Unknown function " + name);
+    }
+    return it->second();
+}
+
+std::vector<std::string> FunctionRegistry::get_names() const {
+    std::vector<std::string> names;
+    for (auto& el : factories) {
+        names.push_back(el.first);
+    }
+    return names;
+}
+
+void register_builtin_functions(FunctionRegistry& registry) {
+    registry.add("func1", []() {return std::make_shared<Func1>();});
+    registry.add("func2", []() {return std::make_shared<Func2>();});
+    registry.add("func3", []() {return std::make_shared<Func3>();});
+    registry.add("ravine", []() {return std::make_shared<RavineFunction>();});
+    registry.add("func3dim1", []() {return std::make_shared<Func3dim1>();});
+    registry.add("func3dim2", []() {return std::make_shared<Func3dim2>();});
+    registry.add("func4dim1", []() {return std::make_shared<Func4dim1>();});
+    registry.add("func4dim2", []() {return std::make_shared<Func4dim2>();});
+}
+
+
+namespace {
+
+/**
+ * @brief What register_function of the host receives as registry.
+ *
+ */
+struct LoadContext {
+    FunctionRegistry* registry;
+    std::shared_ptr<void> handle;
+};
+
+/**
+ * @brief Line restriction created by plugin code, keeps the library loaded.
+ *
+ */
+class PluginLineRestriction : public LineRestriction {
+    // declared first, so it is released after restriction
+    std::shared_ptr<void> handle;
+    std::shared_ptr<const LineRestriction> restriction;
+public:
+    PluginLineRestriction(std::shared_ptr<void> handle, std::shared_ptr<const LineRestriction> restriction) :
+        handle(std::move(handle)), restriction(std::move(restriction)) {}
+
+    double value(double alpha) const override {return restriction->value(alpha);}
+    double derivative(double alpha) const override {return restriction->derivative(alpha);}
+};
+
+/**
+ * @brief Function created by plugin code. Forwards every call and keeps
+ * the library loaded while it or anything it created is alive.
+ *
+ */
+class PluginFunction : public Function<> {
+    // declared first, so it is released after func
+    std::shared_ptr<void> handle;
+    std::shared_ptr<Function<>> func;
+public:
+    PluginFunction(std::shared_ptr<void> handle, std::shared_ptr<Function<>> func) :
+        Function(func->get_dim()), handle(std::move(handle)), func(std::move(func)) {}
+
+    size_t get_dim() const override {return func->get_dim();}
+
+    double operator()(const std::vector<double>& x) const override {return (*func)(x);}
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override {
+        return func->get_gradient(x);
+    }
+
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override {
+        func->hessian_vector_product(x, v, out);
+    }
+
+    std::shared_ptr<const LineRestriction> restrict_to_line(const std::vector<double>& x,
+                                                            const std::vector<double>& v) const override {
+        auto restriction = func->restrict_to_line(x, v);
+        if (!restriction) return nullptr;
+        return std::make_shared<PluginLineRestriction>(handle, std::move(restriction));
+    }
+
+    std::shared_ptr<Function> create_instance() const override {
+        return std::make_shared<PluginFunction>(handle, func->create_instance());
+    }
+
+    std::string get_name() const override {return func->get_name();}
+
+    std::uint64_t get_version() const override {return func->get_version();}
+};
+
+void register_plugin_function(void* registry, const char* name, OptimFunctionFactory factory) {
+    auto context = static_cast<LoadContext*>(registry);
+    std::shared_ptr<void> handle = context->handle;
+    std::string function_name = name;
+    context->registry->add(function_name, [handle, factory, function_name]() -> std::shared_ptr<Function<>> {
+        Function<>* func = nullptr;
+        // plugin exceptions are translated while the library is surely loaded
+        try {
+            func = factory();
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Plugin factory of " + function_name + " failed: " + e.what());
+        }
+        catch (...) {
+            throw std::runtime_error("Plugin factory of " + function_name + " failed.");
+        }
+        if (!func) {
+            throw std::runtime_error("Plugin factory of " + function_name + " returned null.");
+        }
+        return std::make_shared<PluginFunction>(handle, std::shared_ptr<Function<>>(func));
+    });
+}
+
+/**
+ * @brief dlopen returns the already loaded library for a known path,
+ * so every load goes through a uniquely named copy.
+ *
+ * @param path
+ * @return std::shared_ptr<void>
+ */
+std::shared_ptr<void> open_private_copy(const std::string& path) {
+    static std::atomic<unsigned> counter{0};
+    fs::path copy = fs::temp_directory_path() / ("optim-plugin-" + std::to_string(getpid()) + "-" +
+        std::to_string(counter++) + "-" + fs::path(path).filename().string());
+    fs::copy_file(path, copy, fs::copy_options::overwrite_existing);
+    void* handle = dlopen(copy.c_str(), RTLD_NOW | RTLD_LOCAL);
+    // the mapping stays valid after the file is removed
+    fs::remove(copy);
+    if (!handle) {
+        throw std::runtime_error("Can not load plugin " + path + ": " + dlerror());
+    }
+    return std::shared_ptr<void>(handle, [](void* h) {dlclose(h);});
+}
+
+}
+
+void FunctionRegistry::load_plugin(const std::string& path) {
+    LoadContext context{this, open_private_copy(path)};
+    auto init = reinterpret_cast<OptimPluginInit>(dlsym(context.handle.get(), OPTIM_PLUGIN_INIT_SYMBOL));
+    if (!init) {
+        throw std::runtime_error("Plugin " + path + " does not export " OPTIM_PLUGIN_INIT_SYMBOL);
+    }
+    OptimPluginHost host{OPTIM_PLUGIN_ABI_VERSION, &context, register_plugin_function};
+    if (init(&host) != 0) {
+        throw std::runtime_error("Plugin " + path + " refused to initialize.");
+    }
+}
+
+size_t FunctionRegistry::load_plugin_directory(const std::string& dir) {
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) return 0;
+
+    std::vector<fs::path> files;
+    for (auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".so") {
+            files.push_back(entry.path());
+        }
+    }
+    // deterministic override order for functions with equal names
+    std::sort(files.begin(), files.end());
+
+    size_t count = 0;
+    for (auto& file : files) {
+        auto mtime = fs::last_write_time(file, ec);
+        auto it = loaded.find(file.string());
+        if (it != loaded.end() && it->second == mtime) continue;
+        try {
+            load_plugin(file.string());
+            loaded[file.string()] = mtime;
+            ++count;
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+        }
+    }
+    return count;
+}
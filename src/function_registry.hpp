@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+
+#include "function.hpp"
+
+/**
+ * @brief Named factories of functions, filled in code or by plugins
+ * (see plugin.hpp). Functions created from a plugin are wrapped so that
+ * they, their create_instance copies and their line restrictions keep
+ * the library loaded while they live. The wrapper hides the dynamic type
+ * of the plugin object. Exceptions of plugin factories are rethrown as
+ * std::runtime_error.
+ *
+ */
+class FunctionRegistry {
+public:
+    using Factory = std::function<std::shared_ptr<Function<>>()>;
+
+    /**
+     * @brief Adds or replaces the factory for name.
+     *
+     * @param name
+     * @param factory
+     */
+    void add(const std::string& name, Factory factory);
+
+    /**
+     * @brief Throws std::invalid_argument for unknown names.
+     *
+     * @param name
+     * @return std::shared_ptr<Function<>>
+     */
+    std::shared_ptr<Function<>> create(const std::string& name) const;
+
+    std::vector<std::string> get_names() const;
+
+    /**
+     * @brief Loads a plugin with dlopen and registers its functions,
+     * replacing functions of the same name. Each load maps a private
+     * copy of the file, so a rebuilt plugin replaces the old one even
+     * while functions of the old one are in use.
+     *
+     * @param path
+     */
+    void load_plugin(const std::string& path);
+
+    /**
+     * @brief Loads every *.so in dir that is new or changed since the
+     * previous call. Broken plugins are reported to std::cerr and skipped.
+     *
+     * @param dir missing directory means no plugins
+     * @return size_t number of loaded plugins
+     */
+    size_t load_plugin_directory(const std::string& dir);
+
+private:
+    std::map<std::string, Factory> factories;
+    std::map<std::string, std::filesystem::file_time_type> loaded;
+};
+
+/**
+ * @brief Registers built-in test functions as func1, func2, func3,
+ * ravine, func3dim1, func3dim2, func4dim1 and func4dim2.
+ *
+ * @param registry
+ */
+void register_builtin_functions(FunctionRegistry& registry);
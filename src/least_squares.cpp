@@ -0,0 +1,299 @@
+#include "least_squares.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+namespace {
+
+void check_problem(const LinearOperator& A, const std::vector<double>& b, const std::vector<double>& x0) {
+    if (b.size() != A.get_rows() || !(x0.empty() || x0.size() == A.get_cols())) {
+        throw std::invalid_argument("Least squares problem has incompatible dimentions.");
+    }
+}
+
+/**
+ * @brief |A x - b|^2 + damping^2 |x|^2 with one product.
+ *
+ */
+double objective(const LinearOperator& A, const std::vector<double>& b, double damping,
+                 const std::vector<double>& x)
+{
+    std::vector<double> r;
+    A.apply(x, r);
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] -= b[i];
+    }
+    return dot(nullptr, r, r) + damping * damping * dot(nullptr, x, x);
+}
+
+}
+
+DenseOperator::DenseOperator(Mat A) : DenseOperator(std::make_shared<const Mat>(std::move(A))) {}
+
+DenseOperator::DenseOperator(std::shared_ptr<const Mat> A) : A(std::move(A)) {
+    for (const auto& row : *this->A) {
+        if (row.size() != get_cols()) {
+            throw std::invalid_argument("Matrix rows have different sizes.");
+        }
+    }
+}
+
+void DenseOperator::apply(const std::vector<double>& x, std::vector<double>& y) const {
+    y.resize(A->size());
+    for (size_t i = 0; i < A->size(); ++i) {
+        const auto& row = (*A)[i];
+        double s = 0;
+        for (size_t j = 0; j < row.size(); ++j) {
+            s += row[j] * x[j];
+        }
+        y[i] = s;
+    }
+}
+
+void DenseOperator::apply_transposed(const std::vector<double>& y, std::vector<double>& x) const {
+    x.assign(get_cols(), 0);
+    for (size_t i = 0; i < A->size(); ++i) {
+        const auto& row = (*A)[i];
+        for (size_t j = 0; j < row.size(); ++j) {
+            x[j] += row[j] * y[i];
+        }
+    }
+}
+
+SparseOperator::SparseOperator(CSRMatrix A) : A(std::make_shared<const CSRMatrix>(std::move(A))) {}
+
+SparseOperator::SparseOperator(std::shared_ptr<const CSRMatrix> A) : A(std::move(A)) {}
+
+void SparseOperator::apply(const std::vector<double>& x, std::vector<double>& y) const {
+    y.resize(A->rows);
+    A->multiply(x.data(), y.data(), 0, A->rows);
+}
+
+void SparseOperator::apply_transposed(const std::vector<double>& y, std::vector<double>& x) const {
+    x = A->multiply_transposed(y);
+}
+
+
+LeastSquaresFunction::LeastSquaresFunction(std::shared_ptr<const LinearOperator> A,
+                                           std::vector<double> b, double damping) :
+    Function(A->get_cols()), A(std::move(A)), b(std::move(b)), damping(damping)
+{
+    check_problem(*this->A, this->b, {});
+}
+
+std::vector<double> LeastSquaresFunction::residual(const std::vector<double>& x) const {
+    std::vector<double> r;
+    A->apply(x, r);
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] -= b[i];
+    }
+    return r;
+}
+
+double LeastSquaresFunction::operator()(const std::vector<double>& x) const {
+    return objective(*A, b, damping, x);
+}
+
+std::vector<double> LeastSquaresFunction::get_gradient(const std::vector<double>& x) const {
+    // 2 A^T (A x - b) + 2 damping^2 x
+    std::vector<double> grad;
+    A->apply_transposed(residual(x), grad);
+    for (size_t j = 0; j < grad.size(); ++j) {
+        grad[j] = 2 * (grad[j] + damping * damping * x[j]);
+    }
+    return grad;
+}
+
+void LeastSquaresFunction::hessian_vector_product(const std::vector<double>&, const std::vector<double>& v,
+                                                  std::vector<double>& out) const {
+    std::vector<double> av;
+    A->apply(v, av);
+    A->apply_transposed(av, out);
+    for (size_t j = 0; j < out.size(); ++j) {
+        out[j] = 2 * (out[j] + damping * damping * v[j]);
+    }
+}
+
+std::shared_ptr<const LineRestriction> LeastSquaresFunction::restrict_to_line(
+    const std::vector<double>& x, const std::vector<double>& v) const
+{
+    // |r + alpha A v|^2 + damping^2 |x + alpha v|^2, two products per line
+    std::vector<double> r = residual(x);
+    std::vector<double> av;
+    A->apply(v, av);
+    double d2 = damping * damping;
+    return std::make_shared<PolynomialRestriction>(
+        dot(nullptr, r, r) + d2 * dot(nullptr, x, x),
+        2 * (dot(nullptr, r, av) + d2 * dot(nullptr, x, v)),
+        dot(nullptr, av, av) + d2 * dot(nullptr, v, v));
+}
+
+std::shared_ptr<Function<>> LeastSquaresFunction::create_instance() const {
+    return std::make_shared<LeastSquaresFunction>(*this);
+}
+
+std::string LeastSquaresFunction::get_name() const {
+    return "Linear least squares";
+}
+
+
+CGLS::CGLS(double damping, double tolerance, size_t max_iters) :
+    damping(damping), tolerance(tolerance), max_iters(max_iters) {}
+
+BestParams CGLS::solve(const LinearOperator& A, const std::vector<double>& b,
+                       const std::vector<double>& x0) const
+{
+    OPTIM_TRACE_SCOPE("CGLS::solve");
+    check_problem(A, b, x0);
+    size_t n = A.get_cols();
+    double d2 = damping * damping;
+    std::vector<double> x = x0.empty() ? std::vector<double>(n, 0.) : x0;
+
+    // r = b - A x, s = A^T r - damping^2 x is minus half the gradient
+    std::vector<double> r;
+    A.apply(x, r);
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] = b[i] - r[i];
+    }
+    std::vector<double> s;
+    A.apply_transposed(r, s);
+    for (size_t j = 0; j < n; ++j) {
+        s[j] -= d2 * x[j];
+    }
+    std::vector<double> p = s;
+    std::vector<double> q;
+    double gamma = dot(nullptr, s, s);
+    double target = tolerance * tolerance * gamma;
+
+    size_t iters = 0;
+    while (iters < max_iters && gamma > target) {
+        A.apply(p, q);
+        double delta = dot(nullptr, q, q) + d2 * dot(nullptr, p, p);
+        if (delta <= 0) break;
+        double alpha = gamma / delta;
+        for (size_t j = 0; j < n; ++j) {
+            x[j] += alpha * p[j];
+        }
+        for (size_t i = 0; i < r.size(); ++i) {
+            r[i] -= alpha * q[i];
+        }
+        A.apply_transposed(r, s);
+        for (size_t j = 0; j < n; ++j) {
+            s[j] -= d2 * x[j];
+        }
+        double new_gamma = dot(nullptr, s, s);
+        double beta = new_gamma / gamma;
+        gamma = new_gamma;
+        for (size_t j = 0; j < n; ++j) {
+            p[j] = s[j] + beta * p[j];
+        }
+        ++iters;
+    }
+
+    BestParams result;
+    result.minimum_value = objective(A, b, damping, x);
+    result.minimum_point = std::move(x);
+    result.iter_number = iters;
+    result.cancelled = false;
+    return result;
+}
+
+
+LSQR::LSQR(double damping, double tolerance, size_t max_iters) :
+    damping(damping), tolerance(tolerance), max_iters(max_iters) {}
+
+BestParams LSQR::solve(const LinearOperator& A, const std::vector<double>& b,
+                       const std::vector<double>& x0) const
+{
+    OPTIM_TRACE_SCOPE("LSQR::solve");
+    check_problem(A, b, x0);
+    size_t m = A.get_rows();
+    size_t n = A.get_cols();
+    std::vector<double> x = x0.empty() ? std::vector<double>(n, 0.) : x0;
+
+    // bidiagonalization of [A; damping I] started from its residual
+    // [b - A x0; -damping x0], u = [ua; ud] has m + n entries
+    std::vector<double> ua;
+    A.apply(x, ua);
+    for (size_t i = 0; i < m; ++i) {
+        ua[i] = b[i] - ua[i];
+    }
+    std::vector<double> ud(n);
+    for (size_t j = 0; j < n; ++j) {
+        ud[j] = -damping * x[j];
+    }
+    auto scale = [](std::vector<double>& a, double factor) {
+        for (auto& el : a) el *= factor;
+    };
+
+    double beta = std::sqrt(dot(nullptr, ua, ua) + dot(nullptr, ud, ud));
+    if (beta > 0) {
+        scale(ua, 1 / beta);
+        scale(ud, 1 / beta);
+    }
+    std::vector<double> v;
+    A.apply_transposed(ua, v);
+    for (size_t j = 0; j < n; ++j) {
+        v[j] += damping * ud[j];
+    }
+    double alpha = std::sqrt(dot(nullptr, v, v));
+    if (alpha > 0) scale(v, 1 / alpha);
+
+    std::vector<double> w = v;
+    std::vector<double> av;
+    std::vector<double> atu;
+    double phibar = beta;
+    double rhobar = alpha;
+    // |A^T r - damping^2 x| = phibar alpha |c|, alpha beta at the start
+    double normal_residual = alpha * beta;
+    double target = tolerance * normal_residual;
+
+    size_t iters = 0;
+    while (iters < max_iters && normal_residual > target) {
+        A.apply(v, av);
+        for (size_t i = 0; i < m; ++i) {
+            ua[i] = av[i] - alpha * ua[i];
+        }
+        for (size_t j = 0; j < n; ++j) {
+            ud[j] = damping * v[j] - alpha * ud[j];
+        }
+        beta = std::sqrt(dot(nullptr, ua, ua) + dot(nullptr, ud, ud));
+        if (beta > 0) {
+            scale(ua, 1 / beta);
+            scale(ud, 1 / beta);
+        }
+
+        A.apply_transposed(ua, atu);
+        for (size_t j = 0; j < n; ++j) {
+            v[j] = atu[j] + damping * ud[j] - beta * v[j];
+        }
+        alpha = std::sqrt(dot(nullptr, v, v));
+        if (alpha > 0) scale(v, 1 / alpha);
+
+        // plane rotation eliminating beta from the lower bidiagonal
+        double rho = std::hypot(rhobar, beta);
+        double c = rhobar / rho;
+        double s = beta / rho;
+        double theta = s * alpha;
+        rhobar = -c * alpha;
+        double phi = c * phibar;
+        phibar = s * phibar;
+
+        for (size_t j = 0; j < n; ++j) {
+            x[j] += (phi / rho) * w[j];
+            w[j] = v[j] - (theta / rho) * w[j];
+        }
+        normal_residual = phibar * alpha * std::abs(c);
+        ++iters;
+    }
+
+    BestParams result;
+    result.minimum_value = objective(A, b, damping, x);
+    result.minimum_point = std::move(x);
+    result.iter_number = iters;
+    result.cancelled = false;
+    return result;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "function.hpp"
+#include "sparse_matrix.hpp"
+#include "stepper.hpp"
+
+/**
+ * @brief m x n matrix that is only used through products with A and A^T.
+ *
+ */
+class LinearOperator {
+public:
+    virtual ~LinearOperator() = default;
+
+    virtual size_t get_rows() const = 0;
+    virtual size_t get_cols() const = 0;
+
+    /**
+     * @brief y = A x.
+     *
+     * @param x
+     * @param y resized to get_rows()
+     */
+    virtual void apply(const std::vector<double>& x, std::vector<double>& y) const = 0;
+
+    /**
+     * @brief x = A^T y.
+     *
+     * @param y
+     * @param x resized to get_cols()
+     */
+    virtual void apply_transposed(const std::vector<double>& y, std::vector<double>& x) const = 0;
+};
+
+/**
+ * @brief Dense rows, A^T y is accumulated row by row so both products
+ * read A in storage order. The matrix is shared, not copied.
+ *
+ */
+class DenseOperator : public LinearOperator {
+public:
+    DenseOperator(Mat A);
+    DenseOperator(std::shared_ptr<const Mat> A);
+
+    size_t get_rows() const override {return A->size();}
+    size_t get_cols() const override {return A->empty() ? 0 : (*A)[0].size();}
+    void apply(const std::vector<double>& x, std::vector<double>& y) const override;
+    void apply_transposed(const std::vector<double>& y, std::vector<double>& x) const override;
+
+private:
+    std::shared_ptr<const Mat> A;
+};
+
+class SparseOperator : public LinearOperator {
+public:
+    SparseOperator(CSRMatrix A);
+    SparseOperator(std::shared_ptr<const CSRMatrix> A);
+
+    size_t get_rows() const override {return A->rows;}
+    size_t get_cols() const override {return A->cols;}
+    void apply(const std::vector<double>& x, std::vector<double>& y) const override;
+    void apply_transposed(const std::vector<double>& y, std::vector<double>& x) const override;
+
+private:
+    std::shared_ptr<const CSRMatrix> A;
+};
+
+/**
+ * @brief f(x) = |A x - b|^2 + damping^2 |x|^2 for general optimization
+ * methods. Evaluations use products with A and A^T only, A^T A is never
+ * formed. Line restrictions are exact quadratics.
+ *
+ */
+class LeastSquaresFunction : public Function<> {
+public:
+    /**
+     * @brief Construct a new Least Squares Function object
+     *
+     * @param A
+     * @param b get_rows() entries
+     * @param damping Tikhonov parameter, 0 for plain least squares
+     */
+    LeastSquaresFunction(std::shared_ptr<const LinearOperator> A, std::vector<double> b,
+                         double damping = 0);
+
+    double operator()(const std::vector<double>& x) const override;
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override;
+
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override;
+
+    std::shared_ptr<const LineRestriction> restrict_to_line(const std::vector<double>& x,
+                                                            const std::vector<double>& v) const override;
+
+    std::shared_ptr<Function> create_instance() const override;
+
+    std::string get_name() const override;
+
+private:
+    std::shared_ptr<const LinearOperator> A;
+    std::vector<double> b;
+    double damping;
+
+    /**
+     * @brief Residual A x - b.
+     *
+     */
+    std::vector<double> residual(const std::vector<double>& x) const;
+};
+
+/**
+ * @brief CG applied to the normal equations
+ * (A^T A + damping^2 I) x = A^T b without forming them: one product
+ * with A and one with A^T per iteration. Unconstrained.
+ *
+ */
+class CGLS {
+public:
+    /**
+     * @brief Construct a new CGLS object
+     *
+     * @param damping Tikhonov parameter
+     * @param tolerance stop when |A^T r - damping^2 x| has dropped by
+     * this factor, r = b - A x
+     * @param max_iters
+     */
+    CGLS(double damping = 0, double tolerance = 1e-10, size_t max_iters = 1000);
+
+    /**
+     * @brief Minimizes |A x - b|^2 + damping^2 |x|^2. The minimum value
+     * of the result is this objective.
+     *
+     * @param A
+     * @param b
+     * @param x0 starting point, zero if empty
+     * @return BestParams
+     */
+    BestParams solve(const LinearOperator& A, const std::vector<double>& b,
+                     const std::vector<double>& x0 = {}) const;
+
+private:
+    double damping;
+    double tolerance;
+    size_t max_iters;
+};
+
+/**
+ * @brief LSQR of Paige and Saunders: Golub-Kahan bidiagonalization of
+ * [A; damping I] with the same products per iteration as CGLS, but
+ * numerically more reliable on ill-conditioned A.
+ *
+ */
+class LSQR {
+public:
+    /**
+     * @brief Construct a new LSQR object
+     *
+     * @param damping Tikhonov parameter
+     * @param tolerance stop when the estimate of |A^T r - damping^2 x|
+     * has dropped by this factor
+     * @param max_iters
+     */
+    LSQR(double damping = 0, double tolerance = 1e-10, size_t max_iters = 1000);
+
+    /**
+     * @brief Same contract as CGLS::solve.
+     *
+     */
+    BestParams solve(const LinearOperator& A, const std::vector<double>& b,
+                     const std::vector<double>& x0 = {}) const;
+
+private:
+    double damping;
+    double tolerance;
+    size_t max_iters;
+};
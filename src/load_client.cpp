@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "server.hpp"
+
+namespace {
+
+void print_histogram(const std::string& name, const Histogram& hist) {
+    std::cout << name << ":\n";
+    const auto& counts = hist.get_counts();
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] == 0) continue;
+        std::uint64_t low = i == 0 ? 0 : std::uint64_t(1) << (i - 1);
+        std::cout << "  [" << low << ", " << (i == 0 ? 1 : 2 * low) << "): " << counts[i] << "\n";
+    }
+}
+
+}
+
+/**
+ * Usage: load_client [socket_path] [connections] [jobs_per_connection]
+ *     [function] [dim] [cg|random|newton]
+ * Each connection sends its next job as soon as the previous result
+ * arrives (closed loop). Prints client side latency percentiles and
+ * the server histograms.
+ */
+int main(int argc, char** argv) {
+    std::string socket_path = argc > 1 ? argv[1] : "optim.sock";
+    size_t connections = argc > 2 ? std::stoul(argv[2]) : 4;
+    size_t jobs = argc > 3 ? std::stoul(argv[3]) : 1000;
+    std::string function = argc > 4 ? argv[4] : "func1";
+    size_t dim = argc > 5 ? std::stoul(argv[5]) : 2;
+    std::string method_name = argc > 6 ? argv[6] : "cg";
+
+    JobRequest job;
+    job.function = function;
+    job.bounds.assign(dim, {-2., 2.});
+    job.criterion = EServerCriterion::EPSILON;
+    job.criterion_value = 1e-6;
+    if (method_name == "random") {
+        job.method = EServerMethod::RANDOM_SEARCH;
+        job.criterion = EServerCriterion::ITERATIONS;
+        job.criterion_value = 1000;
+    } else if (method_name == "newton") {
+        job.method = EServerMethod::NEWTON_CG;
+    } else if (method_name != "cg") {
+        std::cerr << "Unknown method " << method_name << "\n";
+        return 1;
+    }
+
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<size_t> failures(connections);
+    std::vector<size_t> hits(connections);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < connections; ++c) {
+        threads.emplace_back([&, c]() {
+            try {
+                OptimizationClient client(socket_path);
+                JobRequest request = job;
+                for (size_t i = 0; i < jobs; ++i) {
+                    request.id = c * jobs + i;
+                    request.seed = request.id;
+                    auto sent = std::chrono::steady_clock::now();
+                    JobResponse response = client.solve(request);
+                    auto done = std::chrono::steady_clock::now();
+                    latencies[c].push_back(std::chrono::duration<double, std::micro>(done - sent).count());
+                    hits[c] += response.cached;
+                    if (!response.ok) {
+                        if (failures[c]++ == 0) std::cerr << response.error << "\n";
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                std::cerr << e.what() << "\n";
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    size_t failed = 0;
+    size_t cached = 0;
+    for (size_t c = 0; c < connections; ++c) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        failed += failures[c];
+        cached += hits[c];
+    }
+    if (all.empty()) return 1;
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double q) {
+        return all[std::min(all.size() - 1, static_cast<size_t>(q * all.size()))];
+    };
+    std::cout << all.size() << " jobs (" << failed << " failed, " << cached << " cache hits) in " << seconds << " s, "
+              << all.size() / seconds << " jobs/s\n";
+    std::cout << "latency us: p50 " << percentile(0.5) << ", p99 " << percentile(0.99)
+              << ", max " << all.back() << "\n";
+
+    try {
+        OptimizationClient client(socket_path);
+        ServerStats stats = client.stats();
+        std::cout << "server: completed " << stats.completed << ", failed " << stats.failed
+                  << ", cache hits " << stats.cache_hits
+                  << ", max queue depth " << stats.max_queue_depth << "\n";
+        print_histogram("server latency us", stats.latency_us);
+        print_histogram("queue depth", stats.queue_depths);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
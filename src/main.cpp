@@ -1,4 +1,5 @@
 #include <iostream>
+#include <cstdlib>
 #include "optimization_method.hpp"
 #include "optim_method_cli.hpp"
 
@@ -51,7 +52,8 @@ int main() {
     // double ans = one_optim.optimize(interval, f4, criterion);
     // std::cout << "one dim opt: " << ans << "\n"; 
 
-    OptimMethodCLI cli;
+    const char* plugin_dir = std::getenv("OPTIM_PLUGIN_DIR");
+    OptimMethodCLI cli(plugin_dir ? plugin_dir : "plugins");
     cli.start();
 
     return 0;
@@ -1,18 +1,27 @@
 #include "optim_method_cli.hpp"
 
-OptimMethodCLI::OptimMethodCLI() : running(true) {
-    functions.push_back(std::make_shared<Func1>());
-    functions.push_back(std::make_shared<Func2>());
-    functions.push_back(std::make_shared<Func3>());
-    functions.push_back(std::make_shared<RavineFunction>());
-    functions.push_back(std::make_shared<Func3dim1>());
-    functions.push_back(std::make_shared<Func3dim2>());
-    functions.push_back(std::make_shared<Func4dim2>());
-    functions.push_back(std::make_shared<Func4dim1>());
+OptimMethodCLI::OptimMethodCLI(std::string plugin_dir) : running(true), plugin_dir(std::move(plugin_dir)) {
+    builtin_functions.push_back(std::make_shared<Func1>());
+    builtin_functions.push_back(std::make_shared<Func2>());
+    builtin_functions.push_back(std::make_shared<Func3>());
+    builtin_functions.push_back(std::make_shared<RavineFunction>());
+    builtin_functions.push_back(std::make_shared<Func3dim1>());
+    builtin_functions.push_back(std::make_shared<Func3dim2>());
+    builtin_functions.push_back(std::make_shared<Func4dim2>());
+    builtin_functions.push_back(std::make_shared<Func4dim1>());
 
+    load_plugins();
     curr_func = functions[0];
 }
 
+void OptimMethodCLI::load_plugins() {
+    if (registry.load_plugin_directory(plugin_dir) == 0 && !functions.empty()) return;
+    functions = builtin_functions;
+    for (auto& name : registry.get_names()) {
+        functions.push_back(registry.create(name));
+    }
+}
+
 void OptimMethodCLI::start() {
     std::cout << "FUNCTION OPTIMIZATION CLI.\n\n";
     init_params();
@@ -187,8 +196,9 @@ void OptimMethodCLI::method_menu() {
     std::cout << "Choose optimization method:\n";
     std::cout << "1) Conjugate gradient method.\n";
     std::cout << "2) Random search.\n";
+    std::cout << "3) Newton conjugate gradient method.\n";
     int choice;
-    validate_uint_input(choice, 2);
+    validate_uint_input(choice, 3);
     switch (choice)
     {
     case CONJ:
@@ -206,8 +216,11 @@ void OptimMethodCLI::method_menu() {
 
         curr_method = std::make_shared<RandomSearch>(delta, p, max_iters);
         break;
+    case NEWTON:
+        curr_method = std::make_shared<NewtonConjugateGradient>();
+        break;
     default:
-        throw "Enter the number (1-2) for optimization method.";
+        throw "Enter the number (1-3) for optimization method.";
         break;
     }   
 }
@@ -261,6 +274,7 @@ void OptimMethodCLI::set_func(int choice) {
 }
 
 void OptimMethodCLI::func_menu() {
+    load_plugins();
     std::cout << "Choose function from the list:\n";
     for (size_t i = 0; i < functions.size(); ++i) {
         std::cout << i+1 << ") " << functions[i]->get_name() << "\n";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "optimization_method.hpp"
+#include "function_registry.hpp"
 #include <memory>
 
 /**
@@ -12,7 +13,10 @@ class OptimMethodCLI {
 private:
     bool running;
 
+    std::vector<std::shared_ptr<Function<>>> builtin_functions;
     std::vector<std::shared_ptr<Function<>>> functions;
+    FunctionRegistry registry;
+    std::string plugin_dir;
     std::shared_ptr<Function<>> curr_func;
     std::shared_ptr<Rectangle> curr_area;
     std::shared_ptr<Criterion> curr_criterion;
@@ -43,11 +47,18 @@ private:
 
     enum EMethod {
         CONJ = 1,
-        RANDOM
+        RANDOM,
+        NEWTON
     };
     
 public:
-    OptimMethodCLI();
+    /**
+     * @brief Construct a new Optim Method CLI object
+     * 
+     * @param plugin_dir directory with function plugins (see plugin.hpp),
+     * rescanned every time the function menu is opened
+     */
+    OptimMethodCLI(std::string plugin_dir = "plugins");
     ~OptimMethodCLI() = default;
 
     /**
@@ -84,6 +95,8 @@ private:
 
     void func_menu();
 
+    void load_plugins();
+
     void area_menu();
 };
 
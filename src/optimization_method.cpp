@@ -1,24 +1,28 @@
 #include "optimization_method.hpp"
 
+#include "separable_function.hpp"
+#include "trace.hpp"
+
 OneDimentionalOptimization::OneDimentionalOptimization(
     double epsilon
 ) : epsilon(epsilon) {}
 
 std::vector<double> OneDimentionalOptimization::optimize(const Rectangle& area, const Function<>& func, const Criterion& criterion) {
-    std::pair<double, double> bounds = area.get_bounding_box()[0];
-    double ri = bounds.second;
-    double li = bounds.first;
-    while (ri - li > epsilon) {
-        double mi = (li + ri) / 2;
-        double derivative = func.get_gradient({mi})[0];
-        if (derivative < 0) {
-            li = mi;
-        } else {
-            ri = mi;
-        }
-    }
-    return {(li + ri) / 2};
-    
+    OPTIM_TRACE_SCOPE("OneDimentionalOptimization::optimize");
+    auto stepper = create_stepper(area, criterion);
+    run_stepper(*stepper, func);
+    best_params = stepper->get_best_params();
+    return best_params.minimum_point;
+}
+
+std::unique_ptr<OptimizationStepper> OneDimentionalOptimization::create_stepper(
+    const Rectangle& area,
+    const Criterion&
+)
+{
+    auto stepper = std::make_unique<OneDimentionalStepper>(area, epsilon);
+    attach(*stepper);
+    return stepper;
 }
 
 std::vector<double> ConjugateGradientMethod::optimize(
@@ -27,114 +31,263 @@ std::vector<double> ConjugateGradientMethod::optimize(
     const Criterion& criterion
 ) 
 {
-    if (!(starting_point.size() == func.get_dim() && func.get_dim() == area.get_dim())) {
+    OPTIM_TRACE_SCOPE("ConjugateGradientMethod::optimize");
+    if (!((starting_point.empty() || starting_point.size() == func.get_dim()) && func.get_dim() == area.get_dim())) {
         throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
     }
 
-    std::random_device device;
-    std::mt19937 gen(device());
-    std::vector<double> x0 = starting_point;
-    if (starting_point.size() == 0) {
-        x0 = area.sample_random_point(gen);
-    }
-
-    std::vector<double> xn = x0;
-    std::vector<double> p0 = func.get_gradient(x0);
-    
-    for (auto &el : p0) el = -el;
-    std::vector<double> pn = p0;
-    std::vector<std::vector<double>> trajectory;
+    std::unique_ptr<ConjugateGradientStepper> stepper = make_stepper(area, criterion);
+    return run(*stepper, area, func);
+}
 
-    Interval interval;
+std::vector<double> ConjugateGradientMethod::resume(
+    const std::string& path,
+    const Rectangle& area,
+    const Function<>& func,
+    const Criterion& criterion
+)
+{
+    if (func.get_dim() != area.get_dim()) {
+        throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
+    }
+    BinaryReader in = BinaryReader::from_file(path);
+    ConjugateGradientStepper stepper(area, criterion, in);
+    attach(stepper);
+    stepper.set_thread_pool(pool);
+    stepper.set_preconditioner(preconditioner);
+    stepper.set_line_search(line_search);
+    stepper.set_k_section_points(k_section_points);
+    return run(stepper, area, func);
+}
 
-    std::shared_ptr<Function<>> f = func.create_instance();
-    AuxiliaryFunction function(xn, pn, f);
+std::vector<double> ConjugateGradientMethod::run(
+    ConjugateGradientStepper& stepper,
+    const Rectangle& area,
+    const Function<>& func
+)
+{
+    if (!low_precision) {
+        run_stepper(stepper, func, probe_pool.get());
+        best_params = stepper.get_best_params();
+        last_state = stepper.get_state();
+        return best_params.minimum_point;
+    }
 
-    while (!criterion.done(trajectory)) {
-        double distance = area.intersect(xn, pn); //Должно возвращать расстояние до границы в направлении pn.
-        interval.set_bounds(0, distance);
-        OneDimentionalOptimization optim_method;
+    if (low_precision->get_dim() != func.get_dim()) {
+        throw std::invalid_argument("Low precision function has incompatible dimention.");
+    }
+    run_stepper(stepper, *low_precision, probe_pool.get());
+    BestParams coarse = stepper.get_best_params();
 
+    IterationCriterion refinement_criterion(refinement_iters);
+    ConjugateGradientStepper refinement(area, refinement_criterion, coarse.minimum_point);
+    attach(refinement);
+    // refinement must not overwrite the checkpoint of the main phase
+    refinement.set_checkpoint(nullptr, 0);
+    refinement.set_thread_pool(pool);
+    refinement.set_preconditioner(preconditioner);
+    refinement.set_line_search(line_search);
+    refinement.set_k_section_points(k_section_points);
+    run_stepper(refinement, func, probe_pool.get());
+    best_params = refinement.get_best_params();
+    last_state = refinement.get_state();
+    best_params.iter_number += coarse.iter_number;
+    best_params.cancelled = best_params.cancelled || coarse.cancelled;
+    return best_params.minimum_point;
+}
 
-        function.set_vectors(xn, pn);
-        double alpha_n = optim_method.optimize(interval, function, criterion)[0];
+void ConjugateGradientMethod::set_mixed_precision(
+    std::shared_ptr<Function<>> low_precision,
+    size_t refinement_iters
+)
+{
+    this->low_precision = std::move(low_precision);
+    this->refinement_iters = refinement_iters;
+}
 
+std::unique_ptr<OptimizationStepper> ConjugateGradientMethod::create_stepper(
+    const Rectangle& area,
+    const Criterion& criterion
+)
+{
+    return make_stepper(area, criterion);
+}
 
-        std::vector<double> fn_grad = func.get_gradient(xn);
-        for (size_t i = 0; i < x0.size(); ++i) {
-            xn[i] = xn[i] + alpha_n * pn[i];
+std::unique_ptr<ConjugateGradientStepper> ConjugateGradientMethod::make_stepper(
+    const Rectangle& area,
+    const Criterion& criterion
+)
+{
+    std::unique_ptr<ConjugateGradientStepper> stepper;
+    if (!warm_start.point.empty()) {
+        if (warm_start.point.size() != area.get_dim()) {
+            throw std::invalid_argument("Warm start state has incompatible dimention.");
         }
+        stepper = std::make_unique<ConjugateGradientStepper>(area, criterion, std::move(warm_start));
+        warm_start = CGState();
+    } else {
+        std::vector<double> x0 = starting_point;
+        if (starting_point.size() == 0) {
+            x0 = area.sample_random_point(gen);
+        }
+        stepper = std::make_unique<ConjugateGradientStepper>(area, criterion, std::move(x0));
+    }
+    attach(*stepper);
+    stepper->set_thread_pool(pool);
+    stepper->set_preconditioner(preconditioner);
+    stepper->set_line_search(line_search);
+    stepper->set_k_section_points(k_section_points);
+    return stepper;
+}
 
-        trajectory.push_back(xn);
-        
+void ConjugateGradientMethod::set_thread_pool(std::shared_ptr<ThreadPool> pool) {
+    this->pool = std::move(pool);
+}
 
-        std::vector<double> fn1_grad = func.get_gradient(xn);
+void ConjugateGradientMethod::set_k_section(size_t points, std::shared_ptr<ThreadPool> pool) {
+    if (points == 0) {
+        throw std::invalid_argument("K-section search needs at least one probe.");
+    }
+    line_search = ELineSearch::K_SECTION;
+    k_section_points = points;
+    probe_pool = std::move(pool);
+}
 
-        double numerator = 0, denominator = 0;
-        for (size_t i = 0; i < fn1_grad.size(); ++i) {
-            numerator += fn1_grad[i] * fn1_grad[i];
-            denominator += fn_grad[i] * fn_grad[i];
-        }
-        if (denominator < 1e-8 || numerator < 1e-10) break;
-        double beta = numerator / denominator;
+NewtonConjugateGradient::NewtonConjugateGradient(
+    size_t max_inner_iters
+) : max_inner_iters(max_inner_iters) {}
 
+std::vector<double> NewtonConjugateGradient::optimize(
+    const Rectangle& area,
+    const Function<>& func,
+    const Criterion& criterion
+)
+{
+    OPTIM_TRACE_SCOPE("NewtonConjugateGradient::optimize");
+    if (!((starting_point.empty() || starting_point.size() == func.get_dim()) && func.get_dim() == area.get_dim())) {
+        throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
+    }
 
-        for (size_t i = 0; i < pn.size(); ++i) {
-            pn[i] = -fn1_grad[i] + beta * pn[i];
-        }
+    auto stepper = create_stepper(area, criterion);
+    run_stepper(*stepper, func);
+    best_params = stepper->get_best_params();
+    return best_params.minimum_point;
+}
 
+std::unique_ptr<OptimizationStepper> NewtonConjugateGradient::create_stepper(
+    const Rectangle& area,
+    const Criterion& criterion
+)
+{
+    // fail before the run instead of silently skipping every checkpoint
+    if (checkpoint_writer && checkpoint_every) {
+        throw std::logic_error(get_name() + " does not support checkpoints.");
+    }
+    std::vector<double> x0 = starting_point;
+    if (starting_point.size() == 0) {
+        x0 = area.sample_random_point(gen);
     }
-    best_params.minimum_point = xn;
-    best_params.iter_number = trajectory.size();
-    best_params.minimum_value = func(xn);
+    auto stepper = std::make_unique<NewtonCGStepper>(area, criterion, std::move(x0), max_inner_iters);
+    attach(*stepper);
+    return stepper;
+}
 
-    return xn;
+std::vector<double> CoordinateNewtonMethod::optimize(
+    const Rectangle& area,
+    const Function<>& func,
+    const Criterion& criterion
+)
+{
+    OPTIM_TRACE_SCOPE("CoordinateNewtonMethod::optimize");
+    if (!((starting_point.empty() || starting_point.size() == func.get_dim()) && func.get_dim() == area.get_dim())) {
+        throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
+    }
+    if (!dynamic_cast<const SeparableFunctionBase*>(&func)) {
+        throw std::invalid_argument(get_name() + " needs a separable function.");
+    }
+
+    auto stepper = create_stepper(area, criterion);
+    run_stepper(*stepper, func);
+    best_params = stepper->get_best_params();
+    return best_params.minimum_point;
+}
+
+std::unique_ptr<OptimizationStepper> CoordinateNewtonMethod::create_stepper(
+    const Rectangle& area,
+    const Criterion& criterion
+)
+{
+    // fail before the run instead of silently skipping every checkpoint
+    if (checkpoint_writer && checkpoint_every) {
+        throw std::logic_error(get_name() + " does not support checkpoints.");
+    }
+    std::vector<double> x0 = starting_point;
+    if (starting_point.size() == 0) {
+        x0 = area.sample_random_point(gen);
+    }
+    auto stepper = std::make_unique<CoordinateNewtonStepper>(area, criterion, std::move(x0));
+    attach(*stepper);
+    return stepper;
 }
 
 std::vector<double> RandomSearch::optimize(const Rectangle& area, const Function<>& func, const Criterion& criterion) {
-    if (!(starting_point.size() == func.get_dim() && func.get_dim() == area.get_dim())) {
+    OPTIM_TRACE_SCOPE("RandomSearch::optimize");
+    if (!((starting_point.empty() || starting_point.size() == func.get_dim()) && func.get_dim() == area.get_dim())) {
         throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
     }
+    if (sampler && sampler->get_dim() != area.get_dim()) {
+        throw std::invalid_argument("Sampler has incompatible dimention.");
+    }
 
-    std::random_device device;
-    std::mt19937 gen(device());
-    std::uniform_real_distribution<double> dist(0., 1.);
+    auto stepper = make_stepper(area, criterion, gen);
+    run_stepper(*stepper, func);
+    gen = stepper->get_generator();
+    best_params = stepper->get_best_params();
+    return best_params.minimum_point;
+}
 
-    std::vector<double> xn = starting_point;
-    if (starting_point.size() == 0) {
-        xn = area.sample_random_point(gen);
-    }
-    
-    //const std::vector<std::pair<double, double>>& D_bounds = area.get_bounding_box();
-    std::vector<double> y;
-    double delta = delta0;
-    std::vector<std::vector<double>> trajectory;
-    trajectory.push_back(xn);
-
-    size_t iters = 0;
-    while (!criterion.done(trajectory)) {
-        if (iters >= max_iters) break;
-        double beta = dist(gen);
-        bool neighborhood = false;
-        if (beta < p && delta > min_delta) {
-            y = area.intersect_rectangle(Cube(xn, delta, true)).sample_random_point(gen);
-            neighborhood = true;
-        } else {
-            y = area.sample_random_point(gen);
-        }
-        if (func(y) < func(xn)) {
-            trajectory.push_back(y);
-            xn = y;
-            if (neighborhood) delta = alpha * delta;
-        }
-        ++iters;
+std::vector<double> RandomSearch::resume(
+    const std::string& path,
+    const Rectangle& area,
+    const Function<>& func,
+    const Criterion& criterion
+)
+{
+    if (func.get_dim() != area.get_dim()) {
+        throw std::invalid_argument("Optimizaton method got incompatible dimentions.");
     }
-    best_params.iter_number = iters;
-    best_params.minimum_point = xn;
-    best_params.minimum_value = func(xn);
+    if (sampler && sampler->get_dim() != area.get_dim()) {
+        throw std::invalid_argument("Sampler has incompatible dimention.");
+    }
+    BinaryReader in = BinaryReader::from_file(path);
+    RandomSearchStepper stepper(area, criterion, in, p, max_iters, alpha, min_delta, sampler);
+    attach(stepper);
+    run_stepper(stepper, func);
+    gen = stepper.get_generator();
+    best_params = stepper.get_best_params();
+    return best_params.minimum_point;
+}
 
-    return xn;
+std::unique_ptr<OptimizationStepper> RandomSearch::create_stepper(
+    const Rectangle& area,
+    const Criterion& criterion
+)
+{
+    // a copy of gen would repeat the same numbers in every stepper
+    Philox4x32 generator(gen(), gen.get_stream());
+    return make_stepper(area, criterion, generator);
+}
 
+std::unique_ptr<RandomSearchStepper> RandomSearch::make_stepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    Philox4x32 generator
+)
+{
+    auto stepper = std::make_unique<RandomSearchStepper>(area, criterion, starting_point, generator,
+        delta0, p, max_iters, alpha, min_delta, sampler);
+    attach(*stepper);
+    return stepper;
 }
 
 RandomSearch::RandomSearch(double delta0, double p, size_t max_iters, 
@@ -1,23 +1,16 @@
 #pragma once
 
 #include <memory>
+#include <random>
+#include <future>
+#include <cmath>
 
 #include "area.hpp"
+#include "async.hpp"
 #include "function.hpp"
+#include "stepper.hpp"
 #include "stop_criterion.hpp"
 
-/**
- * @brief Struct that contains best params
- * for OptimizationMethos class
- * 
- */
-struct BestParams {
-    std::vector<double> minimum_point;
-    double minimum_value;
-    size_t iter_number;
-};
-
-
 /**
  * @brief Base abstract class for all optimization methods.
  * 
@@ -26,6 +19,7 @@ struct BestParams {
 template <typename T = std::vector<double>>
 class OptimizationMethod {
 public:
+    OptimizationMethod() : gen(std::random_device()()) {}
     virtual ~OptimizationMethod() = default;
 
     /**
@@ -40,6 +34,18 @@ public:
     virtual T optimize(const Rectangle& area, const Function<T>& func,
         const Criterion& criterion) = 0;
 
+    /**
+     * @brief Creates resumable version of the method for the current
+     * settings (starting point, generator, token, channel). Area and
+     * criterion must outlive the stepper.
+     * 
+     * @param area 
+     * @param criterion 
+     * @return std::unique_ptr<OptimizationStepper> 
+     */
+    virtual std::unique_ptr<OptimizationStepper> create_stepper(const Rectangle& area,
+        const Criterion& criterion) = 0;
+
     BestParams get_best_params() {return best_params;}
     virtual std::string get_name() const = 0;
 
@@ -52,9 +58,115 @@ public:
     void set_starting_point(std::vector<double> starting_point) {
         this->starting_point = std::move(starting_point);
     } 
+
+    /**
+     * @brief Makes runs reproducible. Methods with the same seed and
+     * different streams draw independent numbers, so each thread
+     * should get its own stream.
+     * 
+     * @param seed 
+     * @param stream 
+     */
+    void set_seed(std::uint64_t seed, std::uint64_t stream = 0) {
+        gen = Philox4x32(seed, stream);
+    }
+
+    Philox4x32& get_generator() {return gen;}
+
+    /**
+     * @brief Token checked once per iteration, cancelled run stops
+     * and keeps the best point found so far.
+     * 
+     * @param token 
+     */
+    void set_cancellation_token(CancellationToken token) {
+        cancel_token = std::move(token);
+    }
+
+    /**
+     * @brief Channel that receives Progress after every iteration.
+     * Updates are dropped when the consumer falls behind.
+     * 
+     * @param channel nullptr disables progress reporting
+     */
+    void set_progress_channel(std::shared_ptr<ProgressChannel> channel) {
+        progress = std::move(channel);
+    }
+
+    /**
+     * @brief Periodically saves the solver state to path. Files are
+     * written on a background thread and replaced atomically, so path
+     * always holds the last complete checkpoint.
+     * 
+     * @param path empty path disables checkpoints
+     * @param every number of iterations between checkpoints
+     */
+    void set_checkpoint(const std::string& path, size_t every = 100) {
+        checkpoint_writer = path.empty() ? nullptr : std::make_shared<CheckpointWriter>(path);
+        checkpoint_every = every;
+    }
+
+    /**
+     * @brief Blocks until the last checkpoint is written.
+     * 
+     */
+    void flush_checkpoint() {
+        if (checkpoint_writer) checkpoint_writer->flush();
+    }
+
+    /**
+     * @brief Continues a run from the checkpoint at path. With the same
+     * settings, area, func and criterion the result is bit-identical
+     * to the uninterrupted run.
+     * 
+     * @param path 
+     * @param area 
+     * @param func 
+     * @param criterion 
+     * @return T 
+     */
+    virtual T resume(const std::string&, const Rectangle&, const Function<T>&, const Criterion&)
+    {
+        throw std::logic_error(get_name() + " does not support checkpoints.");
+    }
+
+    /**
+     * @brief Runs optimize on a separate thread. Area, func, criterion
+     * and the method itself must outlive the future.
+     * 
+     * @param area 
+     * @param func 
+     * @param criterion 
+     * @param token 
+     * @param channel 
+     * @return std::future<BestParams> 
+     */
+    std::future<BestParams> optimize_async(const Rectangle& area, const Function<T>& func,
+        const Criterion& criterion, CancellationToken token = CancellationToken(),
+        std::shared_ptr<ProgressChannel> channel = nullptr) 
+    {
+        set_cancellation_token(std::move(token));
+        set_progress_channel(std::move(channel));
+        // by reference, a copy would slice subclasses of Rectangle
+        return std::async(std::launch::async, [this, &area, &func, &criterion]() {
+            optimize(area, func, criterion);
+            return get_best_params();
+        });
+    }
 protected:
     std::vector<double> starting_point;
     BestParams best_params;
+    Philox4x32 gen;
+    CancellationToken cancel_token;
+    std::shared_ptr<ProgressChannel> progress;
+    std::shared_ptr<CheckpointWriter> checkpoint_writer;
+    size_t checkpoint_every = 0;
+
+    void attach(OptimizationStepper& stepper) const {
+        stepper.set_cancellation_token(cancel_token);
+        stepper.set_progress_channel(progress);
+        stepper.set_checkpoint(checkpoint_writer, checkpoint_every);
+    }
 };
 
 /**
@@ -71,6 +183,8 @@ public:
 
     std::vector<double> optimize(const Rectangle& area, const Function<>& func,
         const Criterion& criterion) override;
+    std::unique_ptr<OptimizationStepper> create_stepper(const Rectangle& area,
+        const Criterion& criterion) override;
     std::string get_name() const override {
         return "One dimentional optimization";
     }
@@ -84,9 +198,172 @@ class ConjugateGradientMethod : public OptimizationMethod<> {
 public:
     std::vector<double> optimize(const Rectangle& area, const Function<>& func,
         const Criterion& criterion) override;
+    std::unique_ptr<OptimizationStepper> create_stepper(const Rectangle& area,
+        const Criterion& criterion) override;
     std::string get_name() const override {
         return "Conjugate gradient method";
     }
+
+    /**
+     * @brief In mixed precision mode checkpoints cover the low precision
+     * phase, resume then runs refinement as optimize does.
+     * 
+     */
+    std::vector<double> resume(const std::string& path, const Rectangle& area,
+        const Function<>& func, const Criterion& criterion) override;
+
+    /**
+     * @brief Enables mixed precision mode: optimize first runs CG on
+     * low_precision (e.g. QuadraticFormF32 of the same matrix) until
+     * criterion is met, then refines the point on the original function.
+     * Steppers from create_stepper always run in full precision.
+     * 
+     * @param low_precision cheap approximation of the optimized function,
+     * nullptr disables the mode
+     * @param refinement_iters number of fp64 iterations after the fp32 run
+     */
+    void set_mixed_precision(std::shared_ptr<Function<>> low_precision,
+                             size_t refinement_iters = 10);
+
+    /**
+     * @brief Computes dot product reductions on pool. Results do not
+     * depend on the number of threads.
+     * 
+     * @param pool nullptr restores serial reductions
+     */
+    void set_thread_pool(std::shared_ptr<ThreadPool> pool);
+
+    /**
+     * @brief Preconditions directions with M^{-1}, e.g. DiagonalPreconditioner
+     * or AdaptiveDiagonalPreconditioner for badly scaled functions.
+     * Adaptive state is not saved to checkpoints.
+     * 
+     * @param preconditioner nullptr restores plain CG
+     */
+    void set_preconditioner(std::shared_ptr<Preconditioner> preconditioner) {
+        this->preconditioner = std::move(preconditioner);
+    }
+
+    /**
+     * @brief Selects the line search, see ELineSearch. ADAPTIVE by default.
+     * 
+     * @param kind 
+     */
+    void set_line_search(ELineSearch kind) {line_search = kind;}
+
+    /**
+     * @brief Configures K_SECTION line search: each round evaluates
+     * gradients at `points` interior probes concurrently on pool and
+     * shrinks the interval points + 1 times. Pays off when gradients are
+     * expensive and cores are idle. Also enables K_SECTION.
+     * 
+     * @param points probes per round, e.g. number of threads in pool
+     * @param pool must not be the pool of set_thread_pool or a pool used
+     * inside the function, nullptr evaluates probes serially
+     */
+    void set_k_section(size_t points, std::shared_ptr<ThreadPool> pool = nullptr);
+
+    /**
+     * @brief State at the end of the last optimize call.
+     * 
+     * @return const CGState& 
+     */
+    const CGState& get_state() const {return last_state;}
+
+    /**
+     * @brief Next optimize (or create_stepper) continues from state
+     * instead of the starting point, e.g. after coefficients of the
+     * function were slightly changed. Used once.
+     * 
+     * @param state point must lie in the area of the next solve
+     */
+    void set_warm_start(CGState state) {
+        warm_start = std::move(state);
+    }
+
+private:
+    std::unique_ptr<ConjugateGradientStepper> make_stepper(const Rectangle& area,
+        const Criterion& criterion);
+    std::vector<double> run(ConjugateGradientStepper& stepper, const Rectangle& area,
+        const Function<>& func);
+
+    std::shared_ptr<ThreadPool> pool;
+    std::shared_ptr<Preconditioner> preconditioner;
+    ELineSearch line_search = ELineSearch::ADAPTIVE;
+    size_t k_section_points = 3;
+    std::shared_ptr<ThreadPool> probe_pool;
+    CGState last_state;
+    CGState warm_start;
+    std::shared_ptr<Function<>> low_precision;
+    size_t refinement_iters = 0;
+};
+
+/**
+ * @brief Implements truncated Newton method: the Newton system is solved
+ * approximately by linear CG on Hessian-vector products with
+ * Eisenstat-Walker forcing terms, then the step is backtracked
+ * until the Armijo condition holds.
+ * 
+ */
+class NewtonConjugateGradient : public OptimizationMethod<> {
+public:
+
+    /**
+     * @brief Construct a new Newton Conjugate Gradient object
+     * 
+     * @param max_inner_iters limit of inner CG iterations per step,
+     * 0 means dimention of the function
+     */
+    NewtonConjugateGradient(size_t max_inner_iters = 0);
+
+    std::vector<double> optimize(const Rectangle& area, const Function<>& func,
+        const Criterion& criterion) override;
+
+    /**
+     * @brief Throws std::logic_error if checkpoints are set,
+     * the stepper can not save its state.
+     * 
+     */
+    std::unique_ptr<OptimizationStepper> create_stepper(const Rectangle& area,
+        const Criterion& criterion) override;
+    std::string get_name() const override {
+        return "Newton conjugate gradient method";
+    }
+
+private:
+    size_t max_inner_iters;
+};
+
+/**
+ * @brief Minimizes separable functions (SeparableFunctionBase) one
+ * coordinate at a time: each term is minimized over its interval of the
+ * area by Newton steps on its derivative, safeguarded by bisection of a
+ * shrinking bracket. Coordinates are independent, so all of them step
+ * together and the function may split them between threads (see
+ * SeparableFunction::set_thread_pool). Converges to a point where every
+ * term has a local minimum or sits on the boundary.
+ * 
+ */
+class CoordinateNewtonMethod : public OptimizationMethod<> {
+public:
+    /**
+     * @brief Throws std::invalid_argument if func is not separable.
+     * 
+     */
+    std::vector<double> optimize(const Rectangle& area, const Function<>& func,
+        const Criterion& criterion) override;
+
+    /**
+     * @brief The stepper does not check separability, on other functions
+     * it only uses the Hessian diagonal. Throws std::logic_error if
+     * checkpoints are set, the stepper can not save its state.
+     * 
+     */
+    std::unique_ptr<OptimizationStepper> create_stepper(const Rectangle& area,
+        const Criterion& criterion) override;
+    std::string get_name() const override {
+        return "Coordinate Newton method";
+    }
 };
 
 /**
@@ -108,12 +385,40 @@ public:
     RandomSearch(double delta0, double p, size_t max_iters, double alpha=0.9, double min_delta=1e-2);
     std::vector<double> optimize(const Rectangle& area, const Function<>& func,
         const Criterion& criterion) override;
+
+    /**
+     * @brief Each stepper gets its own generator keyed by the next
+     * output of the method's generator, so steppers run side by side
+     * (see run_interleaved) draw independent streams.
+     * 
+     */
+    std::unique_ptr<OptimizationStepper> create_stepper(const Rectangle& area,
+        const Criterion& criterion) override;
     std::string get_name() const override;
+    std::vector<double> resume(const std::string& path, const Rectangle& area,
+        const Function<>& func, const Criterion& criterion) override;
+
+    /**
+     * @brief Draws points from the whole area with sampler (e.g. SobolSampler)
+     * instead of uniform numbers from the generator. Points in the
+     * neighborhood of x_n stay uniform. The sequence continues
+     * across optimize calls. Checkpoints store the sampler state and
+     * resume restores it into this sampler.
+     * 
+     * @param sampler nullptr restores uniform sampling
+     */
+    void set_sampler(std::shared_ptr<Sampler> sampler) {
+        this->sampler = std::move(sampler);
+    }
 
 private:
+    std::unique_ptr<RandomSearchStepper> make_stepper(const Rectangle& area,
+        const Criterion& criterion, Philox4x32 generator);
+
     double delta0;
     double p;
     size_t max_iters;
     double min_delta;
     double alpha;
+    std::shared_ptr<Sampler> sampler;
 };
\ No newline at end of file
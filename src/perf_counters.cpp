@@ -0,0 +1,116 @@
+#include "perf_counters.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+#ifdef __linux__
+
+namespace {
+
+const std::uint64_t COUNTER_CONFIGS[PerfCounters::COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+int open_counter(std::uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    // user space only, allowed with perf_event_paranoid <= 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+}
+
+PerfCounters::PerfCounters() {
+    for (int i = 0; i < COUNTERS; ++i) {
+        fds[i] = open_counter(COUNTER_CONFIGS[i]);
+        if (fds[i] < 0 && error.empty()) {
+            error = std::string("perf_event_open failed: ") + std::strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool PerfCounters::is_available() const {
+    for (int fd : fds) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+void PerfCounters::start() {
+    for (int fd : fds) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    start_ns = now_ns();
+}
+
+PerfSample PerfCounters::stop() {
+    double seconds = (now_ns() - start_ns) * 1e-9;
+    double values[COUNTERS];
+    for (int i = 0; i < COUNTERS; ++i) {
+        values[i] = std::nan("");
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        // value, time enabled, time running
+        std::uint64_t data[3];
+        if (read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+        values[i] = static_cast<double>(data[0]) * data[1] / data[2];
+    }
+    return {values[0], values[1], values[2], values[3], seconds};
+}
+
+#else
+
+PerfCounters::PerfCounters() : error("perf_event_open is Linux only") {
+    for (int& fd : fds) fd = -1;
+}
+
+PerfCounters::~PerfCounters() = default;
+
+bool PerfCounters::is_available() const {return false;}
+
+void PerfCounters::start() {
+    start_ns = now_ns();
+}
+
+PerfSample PerfCounters::stop() {
+    double nan = std::nan("");
+    return {nan, nan, nan, nan, (now_ns() - start_ns) * 1e-9};
+}
+
+#endif
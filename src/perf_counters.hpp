@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief Hardware counter values of one measured region. Counters that
+ * could not be opened are NaN; values are scaled up when the kernel
+ * multiplexed the counters.
+ *
+ */
+struct PerfSample {
+    double cycles;
+    double instructions;
+    /// last level cache misses
+    double cache_misses;
+    double branch_misses;
+    double seconds;
+
+    /**
+     * @brief Instructions per cycle, NaN without counters.
+     *
+     * @return double
+     */
+    double ipc() const {return instructions / cycles;}
+};
+
+/**
+ * @brief Counts cycles, instructions, cache misses and branch misses of
+ * the calling thread with Linux perf_event_open. When counters are not
+ * available (other OS, containers without perf access,
+ * perf_event_paranoid too high) measurements still report time and
+ * get_error() tells why.
+ *
+ */
+class PerfCounters {
+public:
+    static constexpr int COUNTERS = 4;
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief true if at least one hardware counter is open.
+     *
+     * @return true
+     * @return false
+     */
+    bool is_available() const;
+
+    const std::string& get_error() const {return error;}
+
+    void start();
+    PerfSample stop();
+
+    /**
+     * @brief Measures one call of f.
+     *
+     * @tparam F
+     * @param f
+     * @return PerfSample
+     */
+    template <typename F>
+    PerfSample measure(F&& f) {
+        start();
+        f();
+        return stop();
+    }
+
+private:
+    int fds[COUNTERS];
+    std::string error;
+    std::uint64_t start_ns = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+#include "function.hpp"
+
+/**
+ * @brief Plugin ABI for objective functions built as shared libraries.
+ * A plugin exports
+ *
+ *     extern "C" int optim_plugin_init(const OptimPluginHost* host);
+ *
+ * which checks host->abi_version and registers its functions with
+ * optim_register_function, returning 0 on success. Plugins must be built
+ * with the same compiler and standard library as the host, because
+ * Function<> objects cross the library boundary.
+ *
+ */
+#define OPTIM_PLUGIN_ABI_VERSION 1
+#define OPTIM_PLUGIN_INIT_SYMBOL "optim_plugin_init"
+
+extern "C" {
+
+typedef Function<>* (*OptimFunctionFactory)();
+
+struct OptimPluginHost {
+    std::uint32_t abi_version;
+    void* registry;
+    void (*register_function)(void* registry, const char* name, OptimFunctionFactory factory);
+};
+
+typedef int (*OptimPluginInit)(const OptimPluginHost* host);
+
+}
+
+/**
+ * @brief Registers default constructible F under name.
+ *
+ * @tparam F
+ * @param host
+ * @param name
+ */
+template <typename F>
+void optim_register_function(const OptimPluginHost* host, const char* name) {
+    host->register_function(host->registry, name, []() -> Function<>* {return new F();});
+}
@@ -0,0 +1,46 @@
+#include "plugin.hpp"
+
+/**
+ * @brief Example plugin: n dimentional Rosenbrock function.
+ *
+ */
+template <size_t N>
+class Rosenbrock : public Function<> {
+public:
+    Rosenbrock() : Function(N) {}
+
+    double operator()(const std::vector<double>& x) const override {
+        double result = 0;
+        for (size_t i = 0; i + 1 < N; ++i) {
+            double a = x[i + 1] - x[i] * x[i];
+            double b = 1 - x[i];
+            result += 100 * a * a + b * b;
+        }
+        return result;
+    }
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override {
+        std::vector<double> grad(N, 0.);
+        for (size_t i = 0; i + 1 < N; ++i) {
+            double a = x[i + 1] - x[i] * x[i];
+            grad[i] += -400 * a * x[i] - 2 * (1 - x[i]);
+            grad[i + 1] += 200 * a;
+        }
+        return grad;
+    }
+
+    std::shared_ptr<Function> create_instance() const override {
+        return std::make_shared<Rosenbrock>(*this);
+    }
+
+    std::string get_name() const override {
+        return "Rosenbrock, n = " + std::to_string(N);
+    }
+};
+
+extern "C" int optim_plugin_init(const OptimPluginHost* host) {
+    if (host->abi_version != OPTIM_PLUGIN_ABI_VERSION) return 1;
+    optim_register_function<Rosenbrock<2>>(host, "rosenbrock2");
+    optim_register_function<Rosenbrock<10>>(host, "rosenbrock10");
+    return 0;
+}
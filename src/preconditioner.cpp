@@ -0,0 +1,90 @@
+#include "preconditioner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+DiagonalPreconditioner::DiagonalPreconditioner(const std::vector<double>& diag) : inv_diag(diag.size()) {
+    for (size_t i = 0; i < diag.size(); ++i) {
+        if (!(diag[i] > 0)) {
+            throw std::invalid_argument("Preconditioner diagonal must be positive.");
+        }
+        inv_diag[i] = 1 / diag[i];
+    }
+}
+
+void DiagonalPreconditioner::apply(const std::vector<double>& g, std::vector<double>& out) const {
+    if (g.size() != inv_diag.size()) {
+        throw std::invalid_argument("Preconditioner has incompatible dimention.");
+    }
+    out.resize(g.size());
+    for (size_t i = 0; i < g.size(); ++i) {
+        out[i] = inv_diag[i] * g[i];
+    }
+}
+
+
+void OperatorPreconditioner::apply(const std::vector<double>& g, std::vector<double>& out) const {
+    out.resize(g.size());
+    op(g, out);
+}
+
+
+AdaptiveDiagonalPreconditioner::AdaptiveDiagonalPreconditioner(double min_diag, double max_diag,
+                                                               size_t max_cycle) :
+    min_diag(min_diag), max_diag(max_diag), max_cycle(max_cycle)
+{
+    if (max_cycle == 0) {
+        throw std::invalid_argument("Preconditioner cycle must be positive.");
+    }
+}
+
+void AdaptiveDiagonalPreconditioner::apply(const std::vector<double>& g, std::vector<double>& out) const {
+    if (diag.size() != g.size()) {
+        out = g;
+        return;
+    }
+    out.resize(g.size());
+    for (size_t i = 0; i < g.size(); ++i) {
+        out[i] = g[i] / diag[i];
+    }
+}
+
+void AdaptiveDiagonalPreconditioner::update(const std::vector<double>& s, const std::vector<double>& y) {
+    double ys = 0;
+    double yy = 0;
+    double ss = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        ys += y[i] * s[i];
+        yy += y[i] * y[i];
+        ss += s[i] * s[i];
+    }
+    // without positive curvature along s the update would lose definiteness
+    if (!(ys > 1e-12 * std::sqrt(yy * ss))) return;
+
+    if (estimate.size() != s.size()) {
+        estimate.assign(s.size(), std::clamp(yy / ys, min_diag, max_diag));
+    }
+    double sds = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        sds += estimate[i] * s[i] * s[i];
+    }
+    for (size_t i = 0; i < s.size(); ++i) {
+        double ds = estimate[i] * s[i];
+        double d = estimate[i] + y[i] * y[i] / ys - ds * ds / sds;
+        estimate[i] = std::clamp(d, min_diag, max_diag);
+    }
+}
+
+bool AdaptiveDiagonalPreconditioner::restart(size_t iterations) {
+    if (iterations < cycle || estimate.empty()) return false;
+    diag = estimate;
+    cycle = std::min(2 * cycle, max_cycle);
+    return true;
+}
+
+void AdaptiveDiagonalPreconditioner::reset() {
+    diag.clear();
+    estimate.clear();
+    cycle = 1;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+/**
+ * @brief Approximation M of the Hessian used by preconditioned
+ * conjugate gradient method, which follows -M^{-1} g instead of -g.
+ *
+ */
+class Preconditioner {
+public:
+    virtual ~Preconditioner() = default;
+
+    /**
+     * @brief out = M^{-1} g, M must be symmetric positive definite.
+     *
+     * @param g
+     * @param out resized to the size of g
+     */
+    virtual void apply(const std::vector<double>& g, std::vector<double>& out) const = 0;
+
+    /**
+     * @brief Called after every step with s = x_{n+1} - x_n and
+     * y = g_{n+1} - g_n. Fixed preconditioners ignore it. M must not
+     * change before the next restart.
+     *
+     */
+    virtual void update(const std::vector<double>&, const std::vector<double>&) {}
+
+    /**
+     * @brief Asked by CG after every step of a cycle. Returning true
+     * restarts CG from -M^{-1} g, adaptive preconditioners switch to
+     * their new M here, so that directions of one cycle stay conjugate.
+     *
+     * @param iterations steps since the last restart
+     * @return true to restart now
+     */
+    virtual bool restart(size_t) {return false;}
+};
+
+/**
+ * @brief M = diag(d) for a user-supplied diagonal, e.g. the diagonal
+ * of the Hessian.
+ *
+ */
+class DiagonalPreconditioner : public Preconditioner {
+    std::vector<double> inv_diag;
+public:
+    DiagonalPreconditioner(const std::vector<double>& diag);
+    void apply(const std::vector<double>& g, std::vector<double>& out) const override;
+};
+
+/**
+ * @brief Arbitrary user-supplied operator g -> M^{-1} g.
+ *
+ */
+class OperatorPreconditioner : public Preconditioner {
+public:
+    using Operator = std::function<void(const std::vector<double>& g, std::vector<double>& out)>;
+
+    OperatorPreconditioner(Operator op) : op(std::move(op)) {}
+    void apply(const std::vector<double>& g, std::vector<double>& out) const override;
+
+private:
+    Operator op;
+};
+
+/**
+ * @brief Diagonal estimated on the fly from gradient differences.
+ * Every step applies the diagonal of the BFGS update to an estimate,
+ * clamped to [min_diag, max_diag]. Costs O(n) per iteration. M is the
+ * estimate adopted at the last restart, CG restarts after cycles of
+ * 1, 2, 4, ... steps up to max_cycle. The estimate carries over
+ * between solves of the same dimention.
+ *
+ */
+class AdaptiveDiagonalPreconditioner : public Preconditioner {
+public:
+    /**
+     * @brief Construct a new Adaptive Diagonal Preconditioner object
+     *
+     * @param min_diag
+     * @param max_diag
+     * @param max_cycle longest CG cycle with a fixed M, at least one
+     */
+    AdaptiveDiagonalPreconditioner(double min_diag = 1e-8, double max_diag = 1e8,
+                                   size_t max_cycle = 16);
+
+    void apply(const std::vector<double>& g, std::vector<double>& out) const override;
+    void update(const std::vector<double>& s, const std::vector<double>& y) override;
+    bool restart(size_t iterations) override;
+
+    /**
+     * @brief Forgets the estimate, M becomes the identity and
+     * the next update starts from a scaled identity.
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Diagonal of the current M, empty for the identity.
+     *
+     */
+    const std::vector<double>& get_diagonal() const {return diag;}
+
+private:
+    double min_diag;
+    double max_diag;
+    size_t max_cycle;
+    size_t cycle = 1;
+    std::vector<double> diag;
+    std::vector<double> estimate;
+};
@@ -0,0 +1,247 @@
+#include "result_cache.hpp"
+
+#include <cerrno>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const std::uint64_t CACHE_MAGIC = 0x48434143534d4743; // "CGMSCACH"
+const std::uint64_t CACHE_VERSION = 1;
+const std::uint64_t INITIAL_CAPACITY = 1024;
+
+const std::uint64_t EMPTY = 0;
+const std::uint64_t FULL = 1;
+/// key is set, other fields are being written
+const std::uint64_t WRITING = 2;
+
+std::uint64_t mix(std::uint64_t h) {
+    // splitmix64 finalizer
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111eb;
+    h ^= h >> 31;
+    return h;
+}
+
+}
+
+ProblemKey ProblemKey::from_bytes(const std::vector<char>& data) {
+    // two lanes with different seeds and multipliers over 8 byte words
+    std::uint64_t a = 0x9e3779b97f4a7c15 ^ data.size();
+    std::uint64_t b = 0xc2b2ae3d27d4eb4f + data.size();
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data.data() + i, 8);
+        a = mix(a ^ word) * 0xff51afd7ed558ccd;
+        b = (b ^ mix(word + 0x165667b19e3779f9)) * 0xc4ceb9fe1a85ec53;
+    }
+    std::uint64_t tail = 0;
+    if (i < data.size()) std::memcpy(&tail, data.data() + i, data.size() - i);
+    a = mix(a ^ tail);
+    b = mix(b ^ mix(tail + 0x27d4eb2f165667c5));
+    return ProblemKey{mix(a + b), mix(a ^ (b << 1))};
+}
+
+
+struct ResultCache::Header {
+    std::uint64_t magic;
+    std::uint64_t version;
+    /// number of records, power of two
+    std::uint64_t capacity;
+    std::uint64_t count;
+};
+
+struct ResultCache::Record {
+    std::uint64_t key_hi;
+    std::uint64_t key_lo;
+    std::uint64_t function_version;
+    std::uint64_t state;
+    double minimum_value;
+    std::uint64_t iter_number;
+    std::uint64_t cancelled;
+    std::uint64_t solve_us;
+    std::uint64_t hits;
+    std::uint64_t dim;
+    double point[MAX_DIM];
+};
+
+ResultCache::ResultCache(std::string path) : path(std::move(path)) {
+    int new_fd = open(this->path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (new_fd < 0) {
+        throw std::runtime_error("Can not open result cache " + this->path + ": " + std::strerror(errno));
+    }
+    if (flock(new_fd, LOCK_EX | LOCK_NB) != 0) {
+        close(new_fd);
+        throw std::runtime_error("Result cache " + this->path + " is used by another process.");
+    }
+    struct stat st;
+    fstat(new_fd, &st);
+    if (st.st_size == 0) {
+        map(new_fd, INITIAL_CAPACITY, true);
+        return;
+    }
+
+    Header head;
+    if (pread(new_fd, &head, sizeof(head), 0) != sizeof(head) || head.magic != CACHE_MAGIC ||
+        head.version != CACHE_VERSION || head.capacity == 0 || (head.capacity & (head.capacity - 1)) ||
+        static_cast<std::uint64_t>(st.st_size) != sizeof(Header) + head.capacity * sizeof(Record))
+    {
+        close(new_fd);
+        throw std::runtime_error("File " + this->path + " is not a result cache.");
+    }
+    map(new_fd, head.capacity, false);
+}
+
+ResultCache::~ResultCache() {
+    unmap();
+}
+
+void ResultCache::map(int new_fd, size_t capacity, bool create) {
+    size_t bytes = sizeof(Header) + capacity * sizeof(Record);
+    if (create && ftruncate(new_fd, bytes) != 0) {
+        close(new_fd);
+        throw std::runtime_error("Can not resize result cache " + path);
+    }
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0);
+    if (ptr == MAP_FAILED) {
+        close(new_fd);
+        throw std::runtime_error("Can not map result cache " + path);
+    }
+    fd = new_fd;
+    data = static_cast<char*>(ptr);
+    mapped_bytes = bytes;
+    if (create) {
+        // ftruncate filled the records with zeros, i.e. EMPTY
+        header() = Header{CACHE_MAGIC, CACHE_VERSION, capacity, 0};
+    }
+}
+
+void ResultCache::unmap() {
+    if (!data) return;
+    msync(data, mapped_bytes, MS_SYNC);
+    munmap(data, mapped_bytes);
+    close(fd);
+    data = nullptr;
+    fd = -1;
+}
+
+ResultCache::Header& ResultCache::header() const {
+    return *reinterpret_cast<Header*>(data);
+}
+
+ResultCache::Record* ResultCache::records() const {
+    return reinterpret_cast<Record*>(data + sizeof(Header));
+}
+
+ResultCache::Record* ResultCache::find(const ProblemKey& key) const {
+    std::uint64_t mask = header().capacity - 1;
+    // load factor stays at most 1/2, so an empty record is always reached
+    for (std::uint64_t i = key.lo & mask;; i = (i + 1) & mask) {
+        Record& record = records()[i];
+        if (record.state == EMPTY || (record.key_hi == key.hi && record.key_lo == key.lo)) {
+            return &record;
+        }
+    }
+}
+
+bool ResultCache::lookup(const ProblemKey& key, std::uint64_t version, CachedResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Record* record = find(key);
+    if (record->state != FULL || record->function_version != version) return false;
+    // a corrupted file must not make us read past the record
+    if (record->dim > MAX_DIM) return false;
+    ++record->hits;
+    result.best.minimum_point.assign(record->point, record->point + record->dim);
+    result.best.minimum_value = record->minimum_value;
+    result.best.iter_number = record->iter_number;
+    result.best.cancelled = record->cancelled != 0;
+    result.solve_us = record->solve_us;
+    result.hits = record->hits;
+    return true;
+}
+
+bool ResultCache::store(const ProblemKey& key, std::uint64_t version, const BestParams& best,
+    std::uint64_t solve_us)
+{
+    if (best.minimum_point.size() > MAX_DIM) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (2 * (header().count + 1) > header().capacity) grow();
+    Record* record = find(key);
+    if (record->state == EMPTY) {
+        record->key_hi = key.hi;
+        record->key_lo = key.lo;
+        ++header().count;
+    }
+    // a torn write leaves WRITING, which lookup treats as a miss; the
+    // fences keep the compiler from moving field writes across the state
+    record->state = WRITING;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    record->function_version = version;
+    record->minimum_value = best.minimum_value;
+    record->iter_number = best.iter_number;
+    record->cancelled = best.cancelled;
+    record->solve_us = solve_us;
+    record->hits = 0;
+    record->dim = best.minimum_point.size();
+    std::copy(best.minimum_point.begin(), best.minimum_point.end(), record->point);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    record->state = FULL;
+    return true;
+}
+
+size_t ResultCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return header().count;
+}
+
+void ResultCache::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    msync(data, mapped_bytes, MS_SYNC);
+}
+
+void ResultCache::grow() {
+    // rehash into path.tmp and rename it over path, so path always
+    // holds a complete table
+    std::string tmp = path + ".tmp";
+    int new_fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (new_fd < 0 || flock(new_fd, LOCK_EX | LOCK_NB) != 0) {
+        if (new_fd >= 0) close(new_fd);
+        throw std::runtime_error("Can not create " + tmp);
+    }
+
+    int old_fd = fd;
+    char* old_data = data;
+    size_t old_bytes = mapped_bytes;
+    const Record* old_records = records();
+    std::uint64_t old_capacity = header().capacity;
+    try {
+        map(new_fd, 2 * old_capacity, true);
+    } catch (...) {
+        unlink(tmp.c_str());
+        throw;
+    }
+
+    for (std::uint64_t i = 0; i < old_capacity; ++i) {
+        if (old_records[i].state != FULL) continue;
+        Record* record = find(ProblemKey{old_records[i].key_hi, old_records[i].key_lo});
+        *record = old_records[i];
+        ++header().count;
+    }
+    msync(data, mapped_bytes, MS_SYNC);
+    munmap(old_data, old_bytes);
+    close(old_fd);
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Can not replace result cache " + path);
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "stepper.hpp"
+
+/**
+ * @brief 128 bit content hash of a problem description.
+ *
+ */
+struct ProblemKey {
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+
+    bool operator==(const ProblemKey& other) const {return hi == other.hi && lo == other.lo;}
+
+    /**
+     * @brief Hashes bytes, e.g. a description written with BinaryWriter.
+     * Not cryptographic, only collisions by chance are unlikely.
+     *
+     * @param data
+     * @return ProblemKey
+     */
+    static ProblemKey from_bytes(const std::vector<char>& data);
+};
+
+/**
+ * @brief Stored result of a solved problem.
+ *
+ */
+struct CachedResult {
+    BestParams best;
+    /// time of the original solve
+    std::uint64_t solve_us = 0;
+    /// lookups that returned this entry
+    std::uint64_t hits = 0;
+};
+
+/**
+ * @brief Persistent map from problem keys to results, kept in a memory
+ * mapped file of fixed size records with linear probing. An entry stores
+ * the version of the function it was computed with, and a lookup with
+ * another version is a miss, as are entries torn by a crash during
+ * store and entries with impossible sizes. Thread safe; a file is used
+ * by one process at a time.
+ *
+ */
+class ResultCache {
+public:
+    /// longest minimum point that fits into a record
+    static constexpr size_t MAX_DIM = 32;
+
+    /**
+     * @brief Opens or creates the cache file.
+     * Throws std::runtime_error if the file is broken or in use.
+     *
+     * @param path
+     */
+    ResultCache(std::string path);
+
+    /**
+     * @brief Flushes the mapping to disk.
+     *
+     */
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /**
+     * @brief Finds the result for key computed with function version.
+     *
+     * @param key
+     * @param version
+     * @param result receives the entry on hit
+     * @return true, if found
+     * @return false, otherwise
+     */
+    bool lookup(const ProblemKey& key, std::uint64_t version, CachedResult& result);
+
+    /**
+     * @brief Adds or replaces the entry for key. Points longer than
+     * MAX_DIM are not stored.
+     *
+     * @param key
+     * @param version
+     * @param best
+     * @param solve_us
+     * @return true, if stored
+     * @return false, otherwise
+     */
+    bool store(const ProblemKey& key, std::uint64_t version, const BestParams& best,
+        std::uint64_t solve_us);
+
+    size_t size();
+
+    /**
+     * @brief Writes modified pages to disk.
+     *
+     */
+    void flush();
+
+    const std::string& get_path() const {return path;}
+
+private:
+    struct Header;
+    struct Record;
+
+    std::string path;
+    int fd = -1;
+    char* data = nullptr;
+    size_t mapped_bytes = 0;
+    std::mutex mutex;
+
+    Header& header() const;
+    Record* records() const;
+    Record* find(const ProblemKey& key) const;
+    void map(int new_fd, size_t capacity, bool create);
+    void unmap();
+    void grow();
+};
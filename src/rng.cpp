@@ -0,0 +1,130 @@
+#include "rng.hpp"
+
+namespace {
+
+constexpr std::uint32_t PHILOX_M0 = 0xD2511F53;
+constexpr std::uint32_t PHILOX_M1 = 0xCD9E8D57;
+constexpr std::uint32_t PHILOX_W0 = 0x9E3779B9;
+constexpr std::uint32_t PHILOX_W1 = 0xBB67AE85;
+constexpr int PHILOX_ROUNDS = 10;
+
+inline double to_unit(std::uint64_t x) {
+    // 53 high bits give every representable double of [0, 1) with step 2^-53
+    return static_cast<double>(x >> 11) * 0x1.0p-53;
+}
+
+}
+
+Philox4x32::Philox4x32(std::uint64_t seed, std::uint64_t stream) :
+    seed(seed), stream(stream), block(0), buffer{0, 0}, buffer_pos(OUTPUTS_PER_BLOCK) {}
+
+void Philox4x32::generate_block(std::uint64_t index, std::uint64_t out[OUTPUTS_PER_BLOCK]) const {
+    std::uint32_t c0 = static_cast<std::uint32_t>(index);
+    std::uint32_t c1 = static_cast<std::uint32_t>(index >> 32);
+    std::uint32_t c2 = static_cast<std::uint32_t>(stream);
+    std::uint32_t c3 = static_cast<std::uint32_t>(stream >> 32);
+    std::uint32_t k0 = static_cast<std::uint32_t>(seed);
+    std::uint32_t k1 = static_cast<std::uint32_t>(seed >> 32);
+    for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+        std::uint64_t p0 = static_cast<std::uint64_t>(PHILOX_M0) * c0;
+        std::uint64_t p1 = static_cast<std::uint64_t>(PHILOX_M1) * c2;
+        std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = static_cast<std::uint32_t>(p1);
+        c2 = n2;
+        c3 = static_cast<std::uint32_t>(p0);
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = static_cast<std::uint64_t>(c0) | (static_cast<std::uint64_t>(c1) << 32);
+    out[1] = static_cast<std::uint64_t>(c2) | (static_cast<std::uint64_t>(c3) << 32);
+}
+
+void Philox4x32::refill() {
+    generate_block(block, buffer);
+    ++block;
+    buffer_pos = 0;
+}
+
+Philox4x32::result_type Philox4x32::operator()() {
+    if (buffer_pos == OUTPUTS_PER_BLOCK) refill();
+    return buffer[buffer_pos++];
+}
+
+double Philox4x32::uniform() {
+    return to_unit((*this)());
+}
+
+void Philox4x32::fill_uniform(double* out, size_t n) {
+    size_t i = 0;
+    // drain outputs left from the previous block to stay in sequence
+    while (i < n && buffer_pos != OUTPUTS_PER_BLOCK) {
+        out[i++] = uniform();
+    }
+
+    const std::uint32_t k0 = static_cast<std::uint32_t>(seed);
+    const std::uint32_t k1 = static_cast<std::uint32_t>(seed >> 32);
+    const std::uint32_t s0 = static_cast<std::uint32_t>(stream);
+    const std::uint32_t s1 = static_cast<std::uint32_t>(stream >> 32);
+
+    // LANES independent counters are advanced together, every inner loop
+    // is over lanes and has no dependencies between iterations
+    while (n - i >= LANES * OUTPUTS_PER_BLOCK) {
+        std::uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+        for (size_t l = 0; l < LANES; ++l) {
+            std::uint64_t index = block + l;
+            c0[l] = static_cast<std::uint32_t>(index);
+            c1[l] = static_cast<std::uint32_t>(index >> 32);
+            c2[l] = s0;
+            c3[l] = s1;
+        }
+        std::uint32_t rk0 = k0, rk1 = k1;
+        for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+            for (size_t l = 0; l < LANES; ++l) {
+                std::uint64_t p0 = static_cast<std::uint64_t>(PHILOX_M0) * c0[l];
+                std::uint64_t p1 = static_cast<std::uint64_t>(PHILOX_M1) * c2[l];
+                std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1[l] ^ rk0;
+                std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3[l] ^ rk1;
+                c0[l] = n0;
+                c1[l] = static_cast<std::uint32_t>(p1);
+                c2[l] = n2;
+                c3[l] = static_cast<std::uint32_t>(p0);
+            }
+            rk0 += PHILOX_W0;
+            rk1 += PHILOX_W1;
+        }
+        for (size_t l = 0; l < LANES; ++l) {
+            out[i + 2 * l] = to_unit(static_cast<std::uint64_t>(c0[l]) | (static_cast<std::uint64_t>(c1[l]) << 32));
+            out[i + 2 * l + 1] = to_unit(static_cast<std::uint64_t>(c2[l]) | (static_cast<std::uint64_t>(c3[l]) << 32));
+        }
+        block += LANES;
+        i += LANES * OUTPUTS_PER_BLOCK;
+    }
+
+    while (i < n) {
+        out[i++] = uniform();
+    }
+}
+
+void Philox4x32::discard(std::uint64_t n) {
+    set_position(get_position() + n);
+}
+
+Philox4x32 Philox4x32::split(std::uint64_t stream) const {
+    return Philox4x32(seed, stream);
+}
+
+std::uint64_t Philox4x32::get_position() const {
+    return block * OUTPUTS_PER_BLOCK - (OUTPUTS_PER_BLOCK - buffer_pos);
+}
+
+void Philox4x32::set_position(std::uint64_t position) {
+    block = position / OUTPUTS_PER_BLOCK;
+    buffer_pos = OUTPUTS_PER_BLOCK;
+    size_t offset = position % OUTPUTS_PER_BLOCK;
+    if (offset) {
+        refill();
+        buffer_pos = offset;
+    }
+}
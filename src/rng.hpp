@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+/**
+ * @brief Counter-based Philox4x32-10 random number generator.
+ *
+ * Every output block is a pure function of (seed, stream, block index),
+ * so generators with the same seed and different streams never overlap
+ * and any position can be reached in O(1). Satisfies
+ * UniformRandomBitGenerator, so it works with std distributions.
+ *
+ */
+class Philox4x32 {
+public:
+    using result_type = std::uint64_t;
+
+    /**
+     * @brief Construct a new Philox4x32 object
+     *
+     * @param seed key of the generator
+     * @param stream independent stream index (e.g. thread number)
+     */
+    Philox4x32(std::uint64_t seed = 0, std::uint64_t stream = 0);
+
+    static constexpr result_type min() {return 0;}
+    static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+    result_type operator()();
+
+    /**
+     * @brief Returns uniform double from [0, 1).
+     *
+     * @return double
+     */
+    double uniform();
+
+    /**
+     * @brief Fills out[0..n) with uniform doubles from [0, 1).
+     * Produces the same sequence as n calls to uniform(), but whole
+     * blocks are generated by a lane-parallel loop the compiler vectorizes.
+     *
+     * @param out
+     * @param n
+     */
+    void fill_uniform(double* out, size_t n);
+
+    /**
+     * @brief Skips n outputs of operator().
+     *
+     * @param n
+     */
+    void discard(std::uint64_t n);
+
+    /**
+     * @brief Returns generator with the same seed and another stream.
+     *
+     * @param stream
+     * @return Philox4x32
+     */
+    Philox4x32 split(std::uint64_t stream) const;
+
+    std::uint64_t get_seed() const {return seed;}
+    std::uint64_t get_stream() const {return stream;}
+
+    /**
+     * @brief Number of outputs of operator() consumed so far.
+     * Together with seed and stream defines the whole state.
+     *
+     * @return std::uint64_t
+     */
+    std::uint64_t get_position() const;
+
+    /**
+     * @brief Restores generator to the given position of the stream.
+     *
+     * @param position
+     */
+    void set_position(std::uint64_t position);
+
+private:
+    static constexpr size_t OUTPUTS_PER_BLOCK = 2;
+    static constexpr size_t LANES = 8;
+
+    std::uint64_t seed;
+    std::uint64_t stream;
+    std::uint64_t block;
+    std::uint64_t buffer[OUTPUTS_PER_BLOCK];
+    size_t buffer_pos;
+
+    void generate_block(std::uint64_t index, std::uint64_t out[OUTPUTS_PER_BLOCK]) const;
+    void refill();
+};
@@ -0,0 +1,307 @@
+#include "sampler.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#include "checkpoint.hpp"
+
+namespace {
+
+void save_generator(const Philox4x32& gen, BinaryWriter& out) {
+    out.write_u64(gen.get_seed());
+    out.write_u64(gen.get_stream());
+    out.write_u64(gen.get_position());
+}
+
+Philox4x32 restore_generator(BinaryReader& in) {
+    std::uint64_t seed = in.read_u64();
+    std::uint64_t stream = in.read_u64();
+    Philox4x32 gen(seed, stream);
+    gen.set_position(in.read_u64());
+    return gen;
+}
+
+}
+
+std::vector<double> Sampler::next() {
+    if (block.empty() || block_pos == BLOCK_SIZE) {
+        block.resize(BLOCK_SIZE * dim);
+        fill(block.data(), BLOCK_SIZE);
+        block_pos = 0;
+    }
+    std::vector<double> point(block.begin() + block_pos * dim,
+                              block.begin() + (block_pos + 1) * dim);
+    ++block_pos;
+    return point;
+}
+
+void Sampler::save(BinaryWriter& out) const {
+    out.write_string(get_name());
+    out.write_u64(dim);
+    out.write_vector(block);
+    out.write_u64(block_pos);
+    save_state(out);
+}
+
+void Sampler::restore(BinaryReader& in) {
+    if (in.read_string() != get_name()) {
+        throw std::invalid_argument("Checkpoint was written by another sampler.");
+    }
+    if (in.read_u64() != dim) {
+        throw std::invalid_argument("Checkpoint has incompatible dimention.");
+    }
+    std::vector<double> saved_block = in.read_vector();
+    std::uint64_t saved_pos = in.read_u64();
+    if ((!saved_block.empty() && saved_block.size() != BLOCK_SIZE * dim) || saved_pos > BLOCK_SIZE) {
+        throw std::invalid_argument("Checkpoint has corrupted sampler state.");
+    }
+    restore_state(in);
+    block = std::move(saved_block);
+    block_pos = saved_pos;
+}
+
+
+UniformSampler::UniformSampler(size_t dim, Philox4x32 gen) : Sampler(dim), gen(gen) {}
+
+void UniformSampler::fill(double* out, size_t count) {
+    gen.fill_uniform(out, count * dim);
+}
+
+std::string UniformSampler::get_name() const {
+    return "Uniform";
+}
+
+void UniformSampler::save_state(BinaryWriter& out) const {
+    save_generator(gen, out);
+}
+
+void UniformSampler::restore_state(BinaryReader& in) {
+    gen = restore_generator(in);
+}
+
+
+namespace {
+
+/**
+ * @brief Primitive polynomial (degree s, coefficients a) and initial
+ * direction numbers m of a Sobol coordinate, from new-joe-kuo-6.21201.
+ *
+ */
+struct SobolPolynomial {
+    unsigned s;
+    unsigned a;
+    std::uint32_t m[7];
+};
+
+const SobolPolynomial SOBOL_POLYNOMIALS[SobolSampler::MAX_DIM - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+    {6, 19, {1, 1, 1, 15, 7, 5}},
+    {6, 22, {1, 3, 1, 15, 13, 25}},
+    {6, 25, {1, 1, 5, 5, 19, 61}},
+    {7, 1, {1, 3, 7, 11, 23, 15, 103}},
+    {7, 4, {1, 3, 7, 13, 13, 15, 69}}
+};
+
+const double TWO_POW_MINUS_32 = 1. / 4294967296.;
+
+size_t lowest_zero_bit(std::uint64_t n) {
+    size_t c = 0;
+    while (n & 1) {
+        n >>= 1;
+        ++c;
+    }
+    return c;
+}
+
+}
+
+SobolSampler::SobolSampler(size_t dim, Philox4x32 gen) :
+    Sampler(dim), directions(dim * BITS), state(dim)
+{
+    if (dim == 0 || dim > MAX_DIM) {
+        throw std::invalid_argument("Sobol sampler supports 1 to 21 dimentions.");
+    }
+    for (size_t j = 0; j < BITS; ++j) {
+        directions[j] = std::uint32_t(1) << (BITS - 1 - j);
+    }
+    for (size_t i = 1; i < dim; ++i) {
+        const SobolPolynomial& poly = SOBOL_POLYNOMIALS[i - 1];
+        std::uint32_t* v = directions.data() + i * BITS;
+        for (size_t j = 0; j < poly.s; ++j) {
+            v[j] = poly.m[j] << (BITS - 1 - j);
+        }
+        for (size_t j = poly.s; j < BITS; ++j) {
+            v[j] = v[j - poly.s] ^ (v[j - poly.s] >> poly.s);
+            for (size_t k = 1; k < poly.s; ++k) {
+                if ((poly.a >> (poly.s - 1 - k)) & 1) v[j] ^= v[j - k];
+            }
+        }
+    }
+    // digital shift: the sequence stays a (t, s)-sequence
+    for (auto& x : state) {
+        x = static_cast<std::uint32_t>(gen());
+    }
+}
+
+void SobolSampler::fill(double* out, size_t count) {
+    for (size_t k = 0; k < count; ++k) {
+        double* point = out + k * dim;
+        for (size_t i = 0; i < dim; ++i) {
+            point[i] = state[i] * TWO_POW_MINUS_32;
+        }
+        // Gray code order changes one direction number per point
+        const std::uint32_t* v = directions.data() + lowest_zero_bit(index);
+        for (size_t i = 0; i < dim; ++i) {
+            state[i] ^= v[i * BITS];
+        }
+        ++index;
+    }
+}
+
+std::string SobolSampler::get_name() const {
+    return "Sobol";
+}
+
+void SobolSampler::save_state(BinaryWriter& out) const {
+    out.write_u64(index);
+    for (std::uint32_t x : state) {
+        out.write_u64(x);
+    }
+}
+
+void SobolSampler::restore_state(BinaryReader& in) {
+    index = in.read_u64();
+    for (auto& x : state) {
+        x = static_cast<std::uint32_t>(in.read_u64());
+    }
+}
+
+
+HaltonSampler::HaltonSampler(size_t dim, Philox4x32 gen) : Sampler(dim), shift(dim) {
+    for (std::uint32_t n = 2; primes.size() < dim; ++n) {
+        bool prime = true;
+        for (std::uint32_t p : primes) {
+            if (p * p > n) break;
+            if (n % p == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime) primes.push_back(n);
+    }
+    gen.fill_uniform(shift.data(), dim);
+}
+
+void HaltonSampler::fill(double* out, size_t count) {
+    for (size_t k = 0; k < count; ++k) {
+        double* point = out + k * dim;
+        ++index;
+        for (size_t i = 0; i < dim; ++i) {
+            // radical inverse of index in base primes[i]
+            const double inv_base = 1. / primes[i];
+            double f = inv_base;
+            double x = 0;
+            for (std::uint64_t n = index; n; n /= primes[i]) {
+                x += f * (n % primes[i]);
+                f *= inv_base;
+            }
+            x += shift[i];
+            point[i] = x >= 1 ? x - 1 : x;
+        }
+    }
+}
+
+std::string HaltonSampler::get_name() const {
+    return "Halton";
+}
+
+void HaltonSampler::save_state(BinaryWriter& out) const {
+    out.write_u64(index);
+    out.write_vector(shift);
+}
+
+void HaltonSampler::restore_state(BinaryReader& in) {
+    std::uint64_t saved_index = in.read_u64();
+    std::vector<double> saved_shift = in.read_vector();
+    if (saved_shift.size() != dim) {
+        throw std::invalid_argument("Checkpoint has corrupted sampler state.");
+    }
+    index = saved_index;
+    shift = std::move(saved_shift);
+}
+
+
+LatinHypercubeSampler::LatinHypercubeSampler(size_t dim, size_t batch_size, Philox4x32 gen) :
+    Sampler(dim), gen(gen), batch_size(batch_size), batch(batch_size * dim), batch_pos(batch_size)
+{
+    if (batch_size == 0) {
+        throw std::invalid_argument("Latin hypercube batch must not be empty.");
+    }
+}
+
+void LatinHypercubeSampler::next_batch() {
+    std::vector<double> jitter(batch_size);
+    std::vector<size_t> perm(batch_size);
+    for (size_t i = 0; i < dim; ++i) {
+        for (size_t k = 0; k < batch_size; ++k) perm[k] = k;
+        // Fisher-Yates shuffle
+        for (size_t k = batch_size - 1; k > 0; --k) {
+            size_t j = static_cast<size_t>(gen.uniform() * (k + 1));
+            std::swap(perm[k], perm[j]);
+        }
+        gen.fill_uniform(jitter.data(), batch_size);
+        for (size_t k = 0; k < batch_size; ++k) {
+            batch[k * dim + i] = (perm[k] + jitter[k]) / batch_size;
+        }
+    }
+    batch_pos = 0;
+}
+
+void LatinHypercubeSampler::fill(double* out, size_t count) {
+    for (size_t k = 0; k < count; ++k) {
+        if (batch_pos == batch_size) next_batch();
+        for (size_t i = 0; i < dim; ++i) {
+            out[k * dim + i] = batch[batch_pos * dim + i];
+        }
+        ++batch_pos;
+    }
+}
+
+std::string LatinHypercubeSampler::get_name() const {
+    return "Latin hypercube";
+}
+
+void LatinHypercubeSampler::save_state(BinaryWriter& out) const {
+    save_generator(gen, out);
+    out.write_u64(batch_size);
+    out.write_vector(batch);
+    out.write_u64(batch_pos);
+}
+
+void LatinHypercubeSampler::restore_state(BinaryReader& in) {
+    gen = restore_generator(in);
+    if (in.read_u64() != batch_size) {
+        throw std::invalid_argument("Checkpoint has another Latin hypercube batch size.");
+    }
+    std::vector<double> saved_batch = in.read_vector();
+    std::uint64_t saved_pos = in.read_u64();
+    if (saved_batch.size() != batch_size * dim || saved_pos > batch_size) {
+        throw std::invalid_argument("Checkpoint has corrupted sampler state.");
+    }
+    batch = std::move(saved_batch);
+    batch_pos = saved_pos;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <string>
+
+#include "rng.hpp"
+
+class BinaryWriter;
+class BinaryReader;
+
+/**
+ * @brief Source of points in the unit cube [0, 1)^dim. Points are
+ * generated in blocks of BLOCK_SIZE and handed out one by one.
+ *
+ */
+class Sampler {
+public:
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    Sampler(size_t dim) : dim(dim) {}
+    virtual ~Sampler() = default;
+
+    size_t get_dim() const {return dim;}
+
+    /**
+     * @brief Next point of the sequence.
+     *
+     * @return std::vector<double>
+     */
+    std::vector<double> next();
+
+    /**
+     * @brief Writes next count points, coordinate i of point k
+     * goes to out[k * dim + i].
+     *
+     * @param out
+     * @param count
+     */
+    virtual void fill(double* out, size_t count) = 0;
+
+    virtual std::string get_name() const = 0;
+
+    /**
+     * @brief Writes the position in the sequence, buffered points included,
+     * so that a restored sampler continues bit-exactly.
+     *
+     * @param out
+     */
+    void save(BinaryWriter& out) const;
+
+    /**
+     * @brief Continues from a state written by save. Throws
+     * std::invalid_argument if it was written by another kind of sampler
+     * or for another dimention.
+     *
+     * @param in
+     */
+    void restore(BinaryReader& in);
+
+protected:
+    size_t dim;
+
+    virtual void save_state(BinaryWriter& out) const = 0;
+    virtual void restore_state(BinaryReader& in) = 0;
+
+private:
+    std::vector<double> block;
+    size_t block_pos = 0;
+};
+
+/**
+ * @brief Independent uniform points.
+ *
+ */
+class UniformSampler : public Sampler {
+    Philox4x32 gen;
+public:
+    UniformSampler(size_t dim, Philox4x32 gen = Philox4x32());
+    void fill(double* out, size_t count) override;
+    std::string get_name() const override;
+
+protected:
+    void save_state(BinaryWriter& out) const override;
+    void restore_state(BinaryReader& in) override;
+};
+
+/**
+ * @brief Sobol sequence with Joe-Kuo direction numbers, randomized
+ * by a digital shift drawn from gen. Supports up to MAX_DIM dimentions.
+ *
+ */
+class SobolSampler : public Sampler {
+public:
+    static constexpr size_t MAX_DIM = 21;
+
+    SobolSampler(size_t dim, Philox4x32 gen = Philox4x32());
+    void fill(double* out, size_t count) override;
+    std::string get_name() const override;
+
+protected:
+    void save_state(BinaryWriter& out) const override;
+    void restore_state(BinaryReader& in) override;
+
+private:
+    static constexpr size_t BITS = 32;
+
+    /// directions[i * BITS + j] is direction number j of coordinate i
+    std::vector<std::uint32_t> directions;
+    std::vector<std::uint32_t> state;
+    std::uint64_t index = 0;
+};
+
+/**
+ * @brief Halton sequence on the first dim primes, randomized
+ * by a random shift modulo 1 of every coordinate.
+ *
+ */
+class HaltonSampler : public Sampler {
+public:
+    HaltonSampler(size_t dim, Philox4x32 gen = Philox4x32());
+    void fill(double* out, size_t count) override;
+    std::string get_name() const override;
+
+protected:
+    void save_state(BinaryWriter& out) const override;
+    void restore_state(BinaryReader& in) override;
+
+private:
+    std::vector<std::uint32_t> primes;
+    std::vector<double> shift;
+    std::uint64_t index = 0;
+};
+
+/**
+ * @brief Latin hypercube design: every batch of batch_size points
+ * has exactly one point in each of batch_size slices of every coordinate.
+ *
+ */
+class LatinHypercubeSampler : public Sampler {
+public:
+    LatinHypercubeSampler(size_t dim, size_t batch_size = 256, Philox4x32 gen = Philox4x32());
+    void fill(double* out, size_t count) override;
+    std::string get_name() const override;
+
+protected:
+    void save_state(BinaryWriter& out) const override;
+    void restore_state(BinaryReader& in) override;
+
+private:
+    Philox4x32 gen;
+    size_t batch_size;
+    std::vector<double> batch;
+    size_t batch_pos;
+
+    void next_batch();
+};
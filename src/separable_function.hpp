@@ -0,0 +1,151 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "function.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * @brief Function f(x) = f_0(x_0) + ... + f_{n-1}(x_{n-1}). The Hessian
+ * is diagonal, so hessian_vector_product(x, v) costs as much as a
+ * gradient, and every term can be minimized on its own (see
+ * CoordinateNewtonMethod).
+ *
+ */
+class SeparableFunctionBase : public Function<> {
+public:
+    using Function::Function;
+
+    /**
+     * @brief Value and gradient in one pass over the coordinates.
+     *
+     * @param x
+     * @param grad resized to the dimention of x
+     * @return double f(x)
+     */
+    virtual double value_and_gradient(const std::vector<double>& x, std::vector<double>& grad) const = 0;
+};
+
+/**
+ * @brief SeparableFunction built from three callables (i, x_i) -> double,
+ * see make_separable_function.
+ *
+ */
+template <typename V, typename D, typename S>
+struct LambdaKernel {
+    V value_fn;
+    D derivative_fn;
+    S second_derivative_fn;
+
+    double value(size_t i, double x) const {return value_fn(i, x);}
+    double derivative(size_t i, double x) const {return derivative_fn(i, x);}
+    double second_derivative(size_t i, double x) const {return second_derivative_fn(i, x);}
+};
+
+/**
+ * @brief Separable function with terms given by Kernel, which provides
+ * value(i, x), derivative(i, x) and second_derivative(i, x) of term i.
+ * Kernel calls are inlined into plain loops over the coordinates, which
+ * the compiler vectorizes for arithmetic kernels.
+ *
+ * @tparam Kernel copyable, calls must be thread safe
+ */
+template <typename Kernel>
+class SeparableFunction : public SeparableFunctionBase {
+private:
+    Kernel kernel;
+    std::string name;
+    std::shared_ptr<ThreadPool> pool;
+
+    template <typename F>
+    void for_blocks(size_t n, F&& body) const {
+        if (pool) {
+            pool->parallel_for(n, body);
+        } else {
+            body(0, n);
+        }
+    }
+
+public:
+    SeparableFunction(size_t dim, Kernel kernel, std::string name = "Separable function") :
+        SeparableFunctionBase(dim), kernel(std::move(kernel)), name(std::move(name)) {}
+
+    /**
+     * @brief Splits coordinates between pool workers. Values are summed
+     * by deterministic_sum, so they do not depend on the thread count.
+     *
+     * @param pool nullptr restores serial evaluation
+     */
+    void set_thread_pool(std::shared_ptr<ThreadPool> pool) {this->pool = std::move(pool);}
+
+    const Kernel& get_kernel() const {return kernel;}
+
+    double operator()(const std::vector<double>& x) const override {
+        return deterministic_sum(pool.get(), x.size(), [&](size_t begin, size_t end) {
+            double result = 0;
+            for (size_t i = begin; i < end; ++i) {
+                result += kernel.value(i, x[i]);
+            }
+            return result;
+        });
+    }
+
+    std::vector<double> get_gradient(const std::vector<double>& x) const override {
+        std::vector<double> grad(x.size());
+        for_blocks(x.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                grad[i] = kernel.derivative(i, x[i]);
+            }
+        });
+        return grad;
+    }
+
+    double value_and_gradient(const std::vector<double>& x, std::vector<double>& grad) const override {
+        grad.resize(x.size());
+        return deterministic_sum(pool.get(), x.size(), [&](size_t begin, size_t end) {
+            double result = 0;
+            for (size_t i = begin; i < end; ++i) {
+                result += kernel.value(i, x[i]);
+                grad[i] = kernel.derivative(i, x[i]);
+            }
+            return result;
+        });
+    }
+
+    void hessian_vector_product(const std::vector<double>& x, const std::vector<double>& v,
+                                std::vector<double>& out) const override {
+        out.resize(x.size());
+        for_blocks(x.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                out[i] = kernel.second_derivative(i, x[i]) * v[i];
+            }
+        });
+    }
+
+    std::shared_ptr<Function> create_instance() const override {
+        return std::make_shared<SeparableFunction>(*this);
+    }
+
+    std::string get_name() const override {return name;}
+};
+
+/**
+ * @brief Separable function from lambdas (size_t i, double x) -> double.
+ *
+ * @param dim
+ * @param value f_i(x)
+ * @param derivative f_i'(x)
+ * @param second_derivative f_i''(x)
+ * @param name
+ */
+template <typename V, typename D, typename S>
+std::shared_ptr<SeparableFunction<LambdaKernel<V, D, S>>> make_separable_function(
+    size_t dim, V value, D derivative, S second_derivative, std::string name = "Separable function")
+{
+    return std::make_shared<SeparableFunction<LambdaKernel<V, D, S>>>(dim,
+        LambdaKernel<V, D, S>{std::move(value), std::move(derivative), std::move(second_derivative)},
+        std::move(name));
+}
@@ -0,0 +1,558 @@
+#include "server.hpp"
+
+#include <cmath>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "optimization_method.hpp"
+
+void Histogram::add(std::uint64_t value) {
+    size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    ++counts[std::min(bucket, BUCKETS - 1)];
+}
+
+std::uint64_t Histogram::quantile(double q) const {
+    std::uint64_t n = total();
+    if (n == 0) return 0;
+    std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * n)));
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return i == 0 ? 0 : std::uint64_t(1) << std::min<size_t>(i, 63);
+    }
+    return std::uint64_t(1) << 63;
+}
+
+std::uint64_t Histogram::total() const {
+    std::uint64_t n = 0;
+    for (auto c : counts) n += c;
+    return n;
+}
+
+void Histogram::write(BinaryWriter& out) const {
+    for (auto c : counts) out.write_u64(c);
+}
+
+Histogram Histogram::read(BinaryReader& in) {
+    Histogram hist;
+    for (auto& c : hist.counts) c = in.read_u64();
+    return hist;
+}
+
+
+void write_job(BinaryWriter& out, const JobRequest& job) {
+    out.write_u64(job.id);
+    out.write_string(job.function);
+    out.write_u64(static_cast<std::uint64_t>(job.method));
+    out.write_u64(static_cast<std::uint64_t>(job.criterion));
+    out.write_double(job.criterion_value);
+    out.write_u64(job.bounds.size());
+    for (auto& [low, high] : job.bounds) {
+        out.write_double(low);
+        out.write_double(high);
+    }
+    out.write_vector(job.starting_point);
+    out.write_u64(job.seed);
+    out.write_double(job.delta0);
+    out.write_double(job.p);
+    out.write_u64(job.max_iters);
+}
+
+JobRequest read_job(BinaryReader& in) {
+    JobRequest job;
+    job.id = in.read_u64();
+    job.function = in.read_string();
+    job.method = static_cast<EServerMethod>(in.read_u64());
+    job.criterion = static_cast<EServerCriterion>(in.read_u64());
+    job.criterion_value = in.read_double();
+    std::uint64_t dim = in.read_u64();
+    for (std::uint64_t i = 0; i < dim; ++i) {
+        double low = in.read_double();
+        double high = in.read_double();
+        job.bounds.emplace_back(low, high);
+    }
+    job.starting_point = in.read_vector();
+    job.seed = in.read_u64();
+    job.delta0 = in.read_double();
+    job.p = in.read_double();
+    job.max_iters = in.read_u64();
+    return job;
+}
+
+void write_response(BinaryWriter& out, const JobResponse& response) {
+    out.write_u64(response.id);
+    out.write_u64(response.ok);
+    out.write_u64(response.cached);
+    out.write_string(response.error);
+    out.write_vector(response.best.minimum_point);
+    out.write_double(response.best.minimum_value);
+    out.write_u64(response.best.iter_number);
+    out.write_u64(response.best.cancelled);
+    out.write_u64(response.queue_us);
+    out.write_u64(response.solve_us);
+}
+
+JobResponse read_response(BinaryReader& in) {
+    JobResponse response;
+    response.id = in.read_u64();
+    response.ok = in.read_u64() != 0;
+    response.cached = in.read_u64() != 0;
+    response.error = in.read_string();
+    response.best.minimum_point = in.read_vector();
+    response.best.minimum_value = in.read_double();
+    response.best.iter_number = in.read_u64();
+    response.best.cancelled = in.read_u64() != 0;
+    response.queue_us = in.read_u64();
+    response.solve_us = in.read_u64();
+    return response;
+}
+
+void write_stats(BinaryWriter& out, const ServerStats& stats) {
+    out.write_u64(stats.queue_depth);
+    out.write_u64(stats.max_queue_depth);
+    out.write_u64(stats.completed);
+    out.write_u64(stats.failed);
+    out.write_u64(stats.cache_hits);
+    stats.latency_us.write(out);
+    stats.queue_depths.write(out);
+}
+
+ServerStats read_stats(BinaryReader& in) {
+    ServerStats stats;
+    stats.queue_depth = in.read_u64();
+    stats.max_queue_depth = in.read_u64();
+    stats.completed = in.read_u64();
+    stats.failed = in.read_u64();
+    stats.cache_hits = in.read_u64();
+    stats.latency_us = Histogram::read(in);
+    stats.queue_depths = Histogram::read(in);
+    return stats;
+}
+
+
+namespace {
+
+void send_all(int fd, const char* data, size_t bytes) {
+    while (bytes) {
+        // MSG_NOSIGNAL: a vanished client is an error, not SIGPIPE
+        ssize_t n = send(fd, data, bytes, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Unix socket write failed.");
+        }
+        data += n;
+        bytes -= n;
+    }
+}
+
+/**
+ * @brief Reads exactly bytes, returns false if the peer closed
+ * the connection before the first byte.
+ *
+ */
+bool recv_all(int fd, char* data, size_t bytes) {
+    size_t received = 0;
+    while (received < bytes) {
+        ssize_t n = recv(fd, data + received, bytes - received, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 && received == 0) return false;
+        if (n <= 0) throw std::runtime_error("Unix socket read failed.");
+        received += n;
+    }
+    return true;
+}
+
+sockaddr_un make_address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("Invalid socket path: " + path);
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+    return addr;
+}
+
+std::uint64_t microseconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+/**
+ * @brief Everything the result of a job depends on. Random search
+ * parameters are skipped for other methods, so they do not split
+ * the cache.
+ *
+ */
+void write_problem(BinaryWriter& out, const JobRequest& job, const Function<>& func) {
+    out.write_string(job.function);
+    out.write_string(func.get_name());
+    out.write_u64(func.get_dim());
+    out.write_u64(static_cast<std::uint64_t>(job.method));
+    out.write_u64(static_cast<std::uint64_t>(job.criterion));
+    out.write_double(job.criterion_value);
+    out.write_u64(job.bounds.size());
+    for (auto& [low, high] : job.bounds) {
+        out.write_double(low);
+        out.write_double(high);
+    }
+    out.write_vector(job.starting_point);
+    out.write_u64(job.seed);
+    if (job.method == EServerMethod::RANDOM_SEARCH) {
+        out.write_double(job.delta0);
+        out.write_double(job.p);
+        out.write_u64(job.max_iters);
+    }
+}
+
+/**
+ * @brief Rejects jobs that would be undefined behaviour or could pin
+ * a worker forever. Throws std::invalid_argument.
+ *
+ */
+void validate_job(const JobRequest& job) {
+    double value = job.criterion_value;
+    if (job.criterion == EServerCriterion::ITERATIONS &&
+        !(value >= 1 && value <= static_cast<double>(MAX_JOB_ITERATIONS)))
+    {
+        throw std::invalid_argument("Iteration count must be in [1, " +
+            std::to_string(MAX_JOB_ITERATIONS) + "].");
+    }
+    if (job.criterion == EServerCriterion::EPSILON && !(std::isfinite(value) && value > 0)) {
+        throw std::invalid_argument("Epsilon must be positive and finite.");
+    }
+    for (auto& [low, high] : job.bounds) {
+        if (!(std::isfinite(low) && std::isfinite(high) && low < high)) {
+            throw std::invalid_argument("Bounds must be finite with low < high.");
+        }
+    }
+    for (double el : job.starting_point) {
+        if (!std::isfinite(el)) {
+            throw std::invalid_argument("Starting point must be finite.");
+        }
+    }
+    if (job.method == EServerMethod::RANDOM_SEARCH) {
+        if (!(std::isfinite(job.delta0) && job.delta0 > 0)) {
+            throw std::invalid_argument("delta0 must be positive and finite.");
+        }
+        if (!(job.p >= 0 && job.p <= 1)) {
+            throw std::invalid_argument("p must be in [0, 1].");
+        }
+        if (job.max_iters > MAX_JOB_ITERATIONS) {
+            throw std::invalid_argument("max_iters must not exceed " +
+                std::to_string(MAX_JOB_ITERATIONS) + ".");
+        }
+    }
+}
+
+}
+
+void write_frame(int fd, const std::vector<char>& data) {
+    std::uint64_t size = data.size();
+    send_all(fd, reinterpret_cast<const char*>(&size), sizeof(size));
+    send_all(fd, data.data(), data.size());
+}
+
+bool read_frame(int fd, std::vector<char>& data) {
+    std::uint64_t size;
+    if (!recv_all(fd, reinterpret_cast<char*>(&size), sizeof(size))) return false;
+    if (size > MAX_FRAME_SIZE) throw std::runtime_error("Frame is too large.");
+    data.resize(size);
+    if (size && !recv_all(fd, data.data(), size)) {
+        throw std::runtime_error("Unix socket read failed.");
+    }
+    return true;
+}
+
+
+struct OptimizationServer::Connection {
+    int fd;
+    /// whole frames only, workers answer concurrently
+    std::mutex write_mutex;
+    std::atomic<bool> done{false};
+
+    Connection(int fd) : fd(fd) {}
+    ~Connection() {close(fd);}
+
+    void send(const std::vector<char>& data) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        write_frame(fd, data);
+    }
+};
+
+OptimizationServer::OptimizationServer(std::string socket_path,
+    std::shared_ptr<const FunctionRegistry> registry, size_t workers,
+    std::shared_ptr<ResultCache> cache) :
+    socket_path(std::move(socket_path)), registry(std::move(registry)), cache(std::move(cache))
+{
+    if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+
+    sockaddr_un addr = make_address(this->socket_path);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) throw std::runtime_error("socket failed.");
+    unlink(this->socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0)
+    {
+        close(listen_fd);
+        throw std::runtime_error("Cannot listen on " + this->socket_path + ": " + std::strerror(errno));
+    }
+
+    for (size_t i = 0; i < workers; ++i) {
+        this->workers.push_back(std::make_unique<Worker>());
+        // responses of typical jobs fit without reallocation
+        this->workers.back()->out.get_buffer().reserve(4096);
+    }
+    for (auto& worker : this->workers) {
+        worker->thread = std::thread(&OptimizationServer::worker_loop, this, std::ref(*worker));
+    }
+    acceptor = std::thread(&OptimizationServer::accept_loop, this);
+}
+
+OptimizationServer::~OptimizationServer() {
+    stopping = true;
+    // wake accept with a connection of our own
+    try {
+        OptimizationClient wake(socket_path);
+    } catch (const std::exception&) {}
+    acceptor.join();
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        for (auto& [connection, reader] : connections) {
+            shutdown(connection->fd, SHUT_RD);
+        }
+        for (auto& [connection, reader] : connections) {
+            reader.join();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        draining = true;
+    }
+    queue_cv.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+ServerStats OptimizationServer::get_stats() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return stats;
+}
+
+void OptimizationServer::accept_loop() {
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (stopping) {
+            if (fd >= 0) close(fd);
+            return;
+        }
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "accept failed: " << std::strerror(errno) << "\n";
+            return;
+        }
+        auto connection = std::make_shared<Connection>(fd);
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        reap_connections();
+        connections.emplace_back(connection,
+            std::thread(&OptimizationServer::read_loop, this, connection));
+    }
+}
+
+void OptimizationServer::reap_connections() {
+    for (size_t i = 0; i < connections.size();) {
+        if (connections[i].first->done) {
+            connections[i].second.join();
+            connections[i] = std::move(connections.back());
+            connections.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+void OptimizationServer::read_loop(std::shared_ptr<Connection> connection) {
+    std::vector<char> frame;
+    try {
+        while (read_frame(connection->fd, frame)) {
+            auto received = std::chrono::steady_clock::now();
+            BinaryReader in(std::move(frame));
+            auto type = static_cast<EMessage>(in.read_u64());
+            if (type == EMessage::JOB) {
+                Job job{read_job(in), connection, received};
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    stats.queue_depths.add(queue.size());
+                    queue.push_back(std::move(job));
+                    stats.queue_depth = queue.size();
+                    stats.max_queue_depth = std::max(stats.max_queue_depth, stats.queue_depth);
+                }
+                queue_cv.notify_one();
+            } else if (type == EMessage::STATS) {
+                BinaryWriter out;
+                out.write_u64(static_cast<std::uint64_t>(EMessage::STATS_REPLY));
+                write_stats(out, get_stats());
+                connection->send(out.get_buffer());
+            } else {
+                throw std::runtime_error("Unknown message type.");
+            }
+            frame.clear();
+        }
+    } catch (const std::exception& e) {
+        if (!stopping) std::cerr << "Connection dropped: " << e.what() << "\n";
+    }
+    connection->done = true;
+}
+
+void OptimizationServer::worker_loop(Worker& worker) {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() {return draining || !queue.empty();});
+            if (queue.empty()) return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            stats.queue_depth = queue.size();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        JobResponse response;
+        response.id = job.request.id;
+        response.queue_us = microseconds(start - job.received);
+        try {
+            solve(worker, job.request, response);
+            response.ok = true;
+        } catch (const std::exception& e) {
+            response.error = e.what();
+        }
+        response.solve_us = microseconds(std::chrono::steady_clock::now() - start);
+
+        worker.out.get_buffer().clear();
+        worker.out.write_u64(static_cast<std::uint64_t>(EMessage::RESULT));
+        write_response(worker.out, response);
+
+        // counted before sending, so a client sees its own jobs in stats
+        std::uint64_t latency = microseconds(std::chrono::steady_clock::now() - job.received);
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stats.latency_us.add(latency);
+            ++(response.ok ? stats.completed : stats.failed);
+            if (response.cached) ++stats.cache_hits;
+        }
+        try {
+            job.connection->send(worker.out.get_buffer());
+        } catch (const std::exception&) {
+            // client is gone, nobody waits for the result
+        }
+    }
+}
+
+void OptimizationServer::solve(Worker& worker, const JobRequest& request, JobResponse& response) {
+    validate_job(request);
+    auto it = worker.functions.find(request.function);
+    if (it == worker.functions.end()) {
+        it = worker.functions.emplace(request.function, registry->create(request.function)).first;
+    }
+    const Function<>& func = *it->second;
+
+    std::unique_ptr<Criterion> criterion;
+    switch (request.criterion) {
+    case EServerCriterion::ITERATIONS:
+        criterion = std::make_unique<IterationCriterion>(static_cast<size_t>(request.criterion_value));
+        break;
+    case EServerCriterion::EPSILON:
+        criterion = std::make_unique<EpsilonCriterion>(request.criterion_value);
+        break;
+    default:
+        throw std::invalid_argument("Unknown criterion.");
+    }
+
+    std::unique_ptr<OptimizationMethod<>> method;
+    switch (request.method) {
+    case EServerMethod::CONJUGATE_GRADIENT:
+        method = std::make_unique<ConjugateGradientMethod>();
+        break;
+    case EServerMethod::RANDOM_SEARCH:
+        method = std::make_unique<RandomSearch>(request.delta0, request.p, request.max_iters);
+        break;
+    case EServerMethod::NEWTON_CG:
+        method = std::make_unique<NewtonConjugateGradient>();
+        break;
+    default:
+        throw std::invalid_argument("Unknown method.");
+    }
+    ProblemKey key;
+    if (cache) {
+        worker.key.get_buffer().clear();
+        write_problem(worker.key, request, func);
+        key = ProblemKey::from_bytes(worker.key.get_buffer());
+        CachedResult result;
+        if (cache->lookup(key, func.get_version(), result)) {
+            response.best = std::move(result.best);
+            response.cached = true;
+            return;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    method->set_seed(request.seed);
+    method->set_starting_point(request.starting_point);
+    method->optimize(Rectangle(request.bounds), func, *criterion);
+    response.best = method->get_best_params();
+    if (cache && !response.best.cancelled) {
+        cache->store(key, func.get_version(), response.best,
+            microseconds(std::chrono::steady_clock::now() - start));
+    }
+}
+
+
+OptimizationClient::OptimizationClient(const std::string& socket_path) {
+    sockaddr_un addr = make_address(socket_path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("socket failed.");
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot connect to " + socket_path + ": " + std::strerror(errno));
+    }
+}
+
+OptimizationClient::~OptimizationClient() {
+    close(fd);
+}
+
+JobResponse OptimizationClient::solve(const JobRequest& job) {
+    BinaryWriter out;
+    out.write_u64(static_cast<std::uint64_t>(EMessage::JOB));
+    write_job(out, job);
+    write_frame(fd, out.get_buffer());
+    BinaryReader in = receive(EMessage::RESULT);
+    return read_response(in);
+}
+
+ServerStats OptimizationClient::stats() {
+    BinaryWriter out;
+    out.write_u64(static_cast<std::uint64_t>(EMessage::STATS));
+    write_frame(fd, out.get_buffer());
+    BinaryReader in = receive(EMessage::STATS_REPLY);
+    return read_stats(in);
+}
+
+BinaryReader OptimizationClient::receive(EMessage expected) {
+    if (!read_frame(fd, frame)) throw std::runtime_error("Server closed the connection.");
+    BinaryReader in(frame);
+    if (static_cast<EMessage>(in.read_u64()) != expected) {
+        throw std::runtime_error("Unexpected message from server.");
+    }
+    return in;
+}
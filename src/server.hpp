@@ -0,0 +1,276 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+#include "checkpoint.hpp"
+#include "function_registry.hpp"
+#include "result_cache.hpp"
+#include "stepper.hpp"
+
+/**
+ * Wire format of the optimization server. Every message is a frame:
+ * u64 payload size followed by the payload written with BinaryWriter.
+ * The payload starts with EMessage. A connection may have many jobs in
+ * flight, results come back in completion order and carry the job id.
+ */
+
+enum class EMessage : std::uint64_t {
+    JOB = 1,
+    STATS = 2,
+    RESULT = 3,
+    STATS_REPLY = 4
+};
+
+enum class EServerMethod : std::uint64_t {
+    CONJUGATE_GRADIENT = 1,
+    RANDOM_SEARCH = 2,
+    NEWTON_CG = 3
+};
+
+enum class EServerCriterion : std::uint64_t {
+    ITERATIONS = 1,
+    EPSILON = 2
+};
+
+/**
+ * @brief One optimization problem. Function is a name from the
+ * server's FunctionRegistry.
+ *
+ */
+struct JobRequest {
+    std::uint64_t id = 0;
+    std::string function;
+    EServerMethod method = EServerMethod::CONJUGATE_GRADIENT;
+    EServerCriterion criterion = EServerCriterion::ITERATIONS;
+    /// number of iterations in [1, MAX_JOB_ITERATIONS] or positive epsilon
+    double criterion_value = 100;
+    std::vector<std::pair<double, double>> bounds;
+    /// empty means random point of the area
+    std::vector<double> starting_point;
+    std::uint64_t seed = 0;
+    /// random search parameters: delta0 > 0, p in [0, 1],
+    /// max_iters up to MAX_JOB_ITERATIONS
+    double delta0 = 1;
+    double p = 0.9;
+    std::uint64_t max_iters = 1000;
+};
+
+/**
+ * @brief Result of a job, error is set when ok is false.
+ *
+ */
+struct JobResponse {
+    std::uint64_t id = 0;
+    bool ok = false;
+    std::string error;
+    BestParams best;
+    /// result was taken from the server's ResultCache
+    bool cached = false;
+    /// time from receiving the job to the start of the solve
+    std::uint64_t queue_us = 0;
+    std::uint64_t solve_us = 0;
+};
+
+/**
+ * @brief Counts of values in power of two buckets: bucket 0 holds 0,
+ * bucket i holds values in [2^(i-1), 2^i).
+ *
+ */
+class Histogram {
+public:
+    static constexpr size_t BUCKETS = 64;
+
+    Histogram() : counts(BUCKETS) {}
+
+    void add(std::uint64_t value);
+
+    /**
+     * @brief Upper bound of the bucket that holds quantile q.
+     *
+     * @param q in [0, 1]
+     * @return std::uint64_t
+     */
+    std::uint64_t quantile(double q) const;
+
+    std::uint64_t total() const;
+
+    const std::vector<std::uint64_t>& get_counts() const {return counts;}
+
+    void write(BinaryWriter& out) const;
+    static Histogram read(BinaryReader& in);
+
+private:
+    std::vector<std::uint64_t> counts;
+};
+
+/**
+ * @brief Server counters, latency is the time from receiving a job
+ * to the finished response in microseconds.
+ *
+ */
+struct ServerStats {
+    std::uint64_t queue_depth = 0;
+    std::uint64_t max_queue_depth = 0;
+    std::uint64_t completed = 0;
+    std::uint64_t failed = 0;
+    std::uint64_t cache_hits = 0;
+    Histogram latency_us;
+    /// queue depth seen by every arriving job
+    Histogram queue_depths;
+};
+
+void write_job(BinaryWriter& out, const JobRequest& job);
+JobRequest read_job(BinaryReader& in);
+void write_response(BinaryWriter& out, const JobResponse& response);
+JobResponse read_response(BinaryReader& in);
+void write_stats(BinaryWriter& out, const ServerStats& stats);
+ServerStats read_stats(BinaryReader& in);
+
+/**
+ * @brief Sends data as one frame. Throws std::runtime_error on failure.
+ *
+ * @param fd
+ * @param data
+ */
+void write_frame(int fd, const std::vector<char>& data);
+
+/**
+ * @brief Receives one frame into data. Throws std::runtime_error
+ * on failure or frames larger than MAX_FRAME_SIZE.
+ *
+ * @param fd
+ * @param data
+ * @return true, if a frame was received
+ * @return false, if the peer closed the connection between frames
+ */
+bool read_frame(int fd, std::vector<char>& data);
+
+constexpr std::uint64_t MAX_FRAME_SIZE = std::uint64_t(64) << 20;
+
+/**
+ * @brief Largest number of iterations a job may ask for, as iteration
+ * criterion or as max_iters of random search.
+ *
+ */
+constexpr std::uint64_t MAX_JOB_ITERATIONS = 10000000;
+
+/**
+ * @brief Long-lived optimization daemon on a Unix domain socket.
+ * Connections are read on their own threads, jobs go to one queue
+ * served by a fixed pool of workers. Each worker owns its response
+ * buffer and its own instances of the registry functions, so functions
+ * with caches are never shared between threads.
+ *
+ */
+class OptimizationServer {
+public:
+    /**
+     * @brief Binds socket_path (replacing a stale socket file)
+     * and starts the threads.
+     *
+     * @param socket_path
+     * @param registry functions available to jobs, must not change
+     * while the server runs
+     * @param workers 0 means hardware concurrency
+     * @param cache results are looked up here before solving and
+     * stored after, keyed by the whole job except its id, nullptr
+     * solves every job
+     */
+    OptimizationServer(std::string socket_path, std::shared_ptr<const FunctionRegistry> registry,
+        size_t workers = 0, std::shared_ptr<ResultCache> cache = nullptr);
+
+    /**
+     * @brief Stops accepting, finishes queued jobs and removes the socket file.
+     *
+     */
+    ~OptimizationServer();
+
+    OptimizationServer(const OptimizationServer&) = delete;
+    OptimizationServer& operator=(const OptimizationServer&) = delete;
+
+    ServerStats get_stats();
+
+    const std::string& get_socket_path() const {return socket_path;}
+
+private:
+    struct Connection;
+
+    struct Job {
+        JobRequest request;
+        std::shared_ptr<Connection> connection;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    struct Worker {
+        BinaryWriter out;
+        /// problem description hashed into the cache key
+        BinaryWriter key;
+        std::map<std::string, std::shared_ptr<Function<>>> functions;
+        std::thread thread;
+    };
+
+    std::string socket_path;
+    std::shared_ptr<const FunctionRegistry> registry;
+    std::shared_ptr<ResultCache> cache;
+    int listen_fd = -1;
+    std::atomic<bool> stopping{false};
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<Job> queue;
+    /// set after the readers stopped, workers exit once the queue is empty
+    bool draining = false;
+    ServerStats stats;
+
+    std::mutex connections_mutex;
+    /// connections with their reader threads
+    std::vector<std::pair<std::shared_ptr<Connection>, std::thread>> connections;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::thread acceptor;
+
+    void accept_loop();
+    void read_loop(std::shared_ptr<Connection> connection);
+    void worker_loop(Worker& worker);
+    void solve(Worker& worker, const JobRequest& request, JobResponse& response);
+    void reap_connections();
+};
+
+/**
+ * @brief Blocking client of OptimizationServer.
+ *
+ */
+class OptimizationClient {
+public:
+    OptimizationClient(const std::string& socket_path);
+    ~OptimizationClient();
+
+    OptimizationClient(const OptimizationClient&) = delete;
+    OptimizationClient& operator=(const OptimizationClient&) = delete;
+
+    /**
+     * @brief Sends the job and waits for its result.
+     *
+     * @param job
+     * @return JobResponse
+     */
+    JobResponse solve(const JobRequest& job);
+
+    ServerStats stats();
+
+private:
+    int fd;
+    std::vector<char> frame;
+
+    BinaryReader receive(EMessage expected);
+};
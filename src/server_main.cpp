@@ -0,0 +1,51 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <pthread.h>
+
+#include "server.hpp"
+
+/**
+ * Usage: optim_server [socket_path] [workers] [result_cache]
+ * Serves built-in functions and plugins from OPTIM_PLUGIN_DIR (default
+ * "plugins") until SIGINT or SIGTERM. With result_cache, results of
+ * repeated jobs are read from that file instead of being recomputed.
+ */
+int main(int argc, char** argv) {
+    std::string socket_path = argc > 1 ? argv[1] : "optim.sock";
+    size_t workers = argc > 2 ? std::stoul(argv[2]) : 0;
+    std::string cache_path = argc > 3 ? argv[3] : "";
+
+    // block before any thread starts, so only sigwait below sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    auto registry = std::make_shared<FunctionRegistry>();
+    register_builtin_functions(*registry);
+    const char* plugin_dir = std::getenv("OPTIM_PLUGIN_DIR");
+    registry->load_plugin_directory(plugin_dir ? plugin_dir : "plugins");
+
+    try {
+        std::shared_ptr<ResultCache> cache;
+        if (!cache_path.empty()) {
+            cache = std::make_shared<ResultCache>(cache_path);
+            std::cout << "Result cache " << cache_path << ": " << cache->size() << " entries\n";
+        }
+        OptimizationServer server(socket_path, registry, workers, cache);
+        std::cout << "Listening on " << server.get_socket_path() << "\n";
+        int sig;
+        sigwait(&signals, &sig);
+        std::cout << "Stopping\n";
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "sparse_matrix.hpp"
+
+#include <stdexcept>
+
+CSRMatrix CSRMatrix::from_dense(const std::vector<std::vector<double>>& dense) {
+    CSRMatrix res;
+    res.cols = dense.empty() ? 0 : dense[0].size();
+    for (auto& row : dense) {
+        if (row.size() != res.cols) {
+            throw std::invalid_argument("Dense matrix rows have different sizes.");
+        }
+        for (size_t j = 0; j < row.size(); ++j) {
+            if (row[j] != 0) {
+                res.col.push_back(j);
+                res.val.push_back(row[j]);
+            }
+        }
+        res.row_ptr.push_back(res.val.size());
+        ++res.rows;
+    }
+    return res;
+}
+
+void CSRMatrix::add_row(const std::vector<std::pair<size_t, double>>& entries) {
+    for (auto& entry : entries) {
+        if (entry.first >= cols) cols = entry.first + 1;
+        col.push_back(entry.first);
+        val.push_back(entry.second);
+    }
+    row_ptr.push_back(val.size());
+    ++rows;
+}
+
+void CSRMatrix::multiply(const double* x, double* y, size_t row_begin, size_t row_end) const {
+    for (size_t i = row_begin; i < row_end; ++i) {
+        double sum = 0;
+        for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+            sum += val[k] * x[col[k]];
+        }
+        y[i - row_begin] = sum;
+    }
+}
+
+std::vector<double> CSRMatrix::multiply(const std::vector<double>& x) const {
+    std::vector<double> y(rows);
+    multiply(x.data(), y.data(), 0, rows);
+    return y;
+}
+
+std::vector<double> CSRMatrix::multiply_transposed(const std::vector<double>& x) const {
+    std::vector<double> y(cols);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+            y[col[k]] += val[k] * x[i];
+        }
+    }
+    return y;
+}
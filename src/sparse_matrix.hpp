@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Square or rectangular matrix in compressed sparse row format.
+ *
+ */
+struct CSRMatrix {
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<size_t> row_ptr{0};
+    std::vector<size_t> col;
+    std::vector<double> val;
+
+    /**
+     * @brief Builds matrix from dense rows, dropping exact zeros.
+     *
+     * @param dense
+     * @return CSRMatrix
+     */
+    static CSRMatrix from_dense(const std::vector<std::vector<double>>& dense);
+
+    /**
+     * @brief Appends row given by pairs (column, value).
+     *
+     * @param entries
+     */
+    void add_row(const std::vector<std::pair<size_t, double>>& entries);
+
+    /**
+     * @brief Computes y[i - row_begin] = (A x)_i for rows [row_begin, row_end).
+     *
+     * @param x
+     * @param y
+     * @param row_begin
+     * @param row_end
+     */
+    void multiply(const double* x, double* y, size_t row_begin, size_t row_end) const;
+
+    /**
+     * @brief Returns A x.
+     *
+     * @param x
+     * @return std::vector<double>
+     */
+    std::vector<double> multiply(const std::vector<double>& x) const;
+
+    /**
+     * @brief Returns A^T x.
+     *
+     * @param x
+     * @return std::vector<double>
+     */
+    std::vector<double> multiply_transposed(const std::vector<double>& x) const;
+
+    size_t get_nnz() const {return val.size();}
+};
@@ -0,0 +1,935 @@
+#include "stepper.hpp"
+
+#include <algorithm>
+
+#include "trace.hpp"
+
+void OptimizationStepper::tell(EvaluationResult result) {
+    if (done) {
+        throw std::logic_error("Stepper has already finished.");
+    }
+    this->result = std::move(result);
+    step();
+}
+
+void OptimizationStepper::evaluate(const Function<>& func, ThreadPool* pool) {
+    EvaluationResult res;
+    if (request.kind == EvaluationRequest::VALUE) {
+        OPTIM_TRACE_SCOPE("evaluate value");
+        res.value = func(request.point);
+    } else if (request.kind == EvaluationRequest::GRADIENT) {
+        OPTIM_TRACE_SCOPE("evaluate gradient");
+        res.gradient = func.get_gradient(request.point);
+    } else if (request.kind == EvaluationRequest::HESSIAN_VECTOR) {
+        OPTIM_TRACE_SCOPE("evaluate hessian-vector");
+        func.hessian_vector_product(request.point, request.direction, res.gradient);
+    } else if (request.kind == EvaluationRequest::LINE_RESTRICTION) {
+        OPTIM_TRACE_SCOPE("evaluate line restriction");
+        res.restriction = func.restrict_to_line(request.point, request.direction);
+    } else {
+        OPTIM_TRACE_SCOPE("evaluate gradient batch");
+        size_t n = request.points.size();
+        res.gradients.resize(n);
+        auto body = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                OPTIM_TRACE_SCOPE("evaluate gradient");
+                res.gradients[i] = func.get_gradient(request.points[i]);
+            }
+        };
+        if (pool) {
+            pool->parallel_for(n, body);
+        } else {
+            body(0, n);
+        }
+    }
+    tell(std::move(res));
+}
+
+void OptimizationStepper::request_value(std::vector<double> x) {
+    request.kind = EvaluationRequest::VALUE;
+    request.point = std::move(x);
+}
+
+void OptimizationStepper::request_gradient(std::vector<double> x) {
+    request.kind = EvaluationRequest::GRADIENT;
+    request.point = std::move(x);
+}
+
+void OptimizationStepper::request_hessian_vector(std::vector<double> x, std::vector<double> v) {
+    request.kind = EvaluationRequest::HESSIAN_VECTOR;
+    request.point = std::move(x);
+    request.direction = std::move(v);
+}
+
+void OptimizationStepper::request_gradients(std::vector<std::vector<double>> points) {
+    request.kind = EvaluationRequest::GRADIENT_BATCH;
+    request.points = std::move(points);
+}
+
+void OptimizationStepper::request_line_restriction(std::vector<double> x, std::vector<double> v) {
+    request.kind = EvaluationRequest::LINE_RESTRICTION;
+    request.point = std::move(x);
+    request.direction = std::move(v);
+}
+
+void OptimizationStepper::publish_progress(size_t iteration, double best_value,
+                                           double gradient_norm) {
+    if (progress) progress->try_push({iteration, best_value, gradient_norm});
+}
+
+void OptimizationStepper::save(BinaryWriter&) const {
+    throw std::logic_error("Stepper does not support checkpoints.");
+}
+
+void OptimizationStepper::checkpoint(size_t iteration) const {
+    if (!checkpoint_writer || checkpoint_every == 0 || iteration == 0 ||
+        iteration % checkpoint_every != 0) {
+        return;
+    }
+    BinaryWriter out;
+    save(out);
+    checkpoint_writer->submit(std::move(out.get_buffer()));
+}
+
+
+void BisectionLineSearch::begin(double left, double right) {
+    this->left = left;
+    this->right = right;
+    iter_number = 0;
+}
+
+void BisectionLineSearch::update(double derivative) {
+    double mi = get_probe();
+    if (derivative < 0) {
+        left = mi;
+    } else {
+        right = mi;
+    }
+    ++iter_number;
+}
+
+
+KSectionLineSearch::KSectionLineSearch(size_t k, double epsilon) : epsilon(epsilon), k(k) {
+    if (k == 0) {
+        throw std::invalid_argument("K-section search needs at least one probe.");
+    }
+}
+
+void KSectionLineSearch::begin(double left, double right) {
+    this->left = left;
+    this->right = right;
+    iter_number = 0;
+}
+
+std::vector<double> KSectionLineSearch::get_probes() const {
+    std::vector<double> probes(k);
+    double h = (right - left) / (k + 1);
+    for (size_t j = 0; j < k; ++j) {
+        probes[j] = left + (j + 1) * h;
+    }
+    return probes;
+}
+
+void KSectionLineSearch::update(const std::vector<double>& derivatives) {
+    std::vector<double> probes = get_probes();
+    // first probe with nonnegative derivative closes the bracket
+    size_t j = 0;
+    while (j < k && derivatives[j] < 0) ++j;
+    if (j > 0) left = probes[j - 1];
+    if (j < k) right = probes[j];
+    ++iter_number;
+}
+
+
+void SecantLineSearch::begin(double slope0, double guess, double max_step) {
+    this->slope0 = slope0;
+    this->max_step = max_step;
+    lo = 0;
+    lo_derivative = slope0;
+    bracketed = false;
+    active = true;
+    iter_number = 0;
+    probe = guess > 0 && guess < max_step ? guess : max_step;
+}
+
+void SecantLineSearch::update(double derivative) {
+    ++iter_number;
+    if (std::abs(derivative) <= sigma * std::abs(slope0) || iter_number >= max_iters) {
+        active = false;
+        return;
+    }
+    if (derivative < 0) {
+        lo = probe;
+        lo_derivative = derivative;
+        if (!bracketed) {
+            if (probe >= max_step) {
+                active = false;
+            } else {
+                probe = std::min(2 * probe, max_step);
+            }
+            return;
+        }
+    } else {
+        hi = probe;
+        hi_derivative = derivative;
+        bracketed = true;
+    }
+    double width = hi - lo;
+    if (width <= 1e-12 * hi) {
+        active = false;
+        return;
+    }
+    double t = lo - lo_derivative * width / (hi_derivative - lo_derivative);
+    // probes away from the ends keep the bracket shrinking
+    probe = std::clamp(t, lo + 0.01 * width, hi - 0.01 * width);
+}
+
+
+OneDimentionalStepper::OneDimentionalStepper(const Rectangle& area, double epsilon) :
+    line_search(epsilon), state(SEARCH)
+{
+    std::pair<double, double> bounds = area.get_bounding_box()[0];
+    line_search.begin(bounds.first, bounds.second);
+    next_probe();
+}
+
+void OneDimentionalStepper::next_probe() {
+    if (line_search.is_active()) {
+        request_gradient({line_search.get_probe()});
+        return;
+    }
+    state = FINAL_VALUE;
+    request_value({line_search.get_result()});
+}
+
+void OneDimentionalStepper::step() {
+    switch (state) {
+    case SEARCH: {
+        OPTIM_TRACE_SCOPE("line search");
+        line_search.update(result.gradient[0]);
+        next_probe();
+        break;
+    }
+    case FINAL_VALUE:
+        best_params.minimum_point = {line_search.get_result()};
+        best_params.minimum_value = result.value;
+        best_params.iter_number = line_search.get_iter_number();
+        done = true;
+        break;
+    }
+}
+
+
+ConjugateGradientStepper::ConjugateGradientStepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    std::vector<double> x0
+) : area(area), criterion(criterion), state(INITIAL_GRADIENT), xn(std::move(x0))
+{
+    request_gradient(xn);
+}
+
+ConjugateGradientStepper::ConjugateGradientStepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    CGState warm_start
+) : area(area), criterion(criterion), state(INITIAL_GRADIENT), xn(warm_start.point),
+    last_step(warm_start.step_length), warm_start(std::move(warm_start))
+{
+    request_gradient(xn);
+}
+
+ConjugateGradientStepper::ConjugateGradientStepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    BinaryReader& in
+) : area(area), criterion(criterion), state(INITIAL_GRADIENT)
+{
+    read_checkpoint_header(in, ECheckpoint::CONJUGATE_GRADIENT);
+    xn = in.read_vector();
+    pn = in.read_vector();
+    fn_grad = in.read_vector();
+    last_step = in.read_double();
+    last_slope = in.read_double();
+    trajectory = this->criterion.restore(in);
+    if (xn.size() != this->area.get_dim() || pn.size() != xn.size() || fn_grad.size() != xn.size()) {
+        throw std::invalid_argument("Checkpoint has incompatible dimention.");
+    }
+    begin_iteration();
+}
+
+void ConjugateGradientStepper::save(BinaryWriter& out) const {
+    write_checkpoint_header(out, ECheckpoint::CONJUGATE_GRADIENT);
+    out.write_vector(xn);
+    out.write_vector(pn);
+    out.write_vector(fn_grad);
+    out.write_double(last_step);
+    out.write_double(last_slope);
+    criterion.save(trajectory, out);
+}
+
+CGState ConjugateGradientStepper::get_state() const {
+    return {xn, pn, fn_grad, last_step};
+}
+
+void ConjugateGradientStepper::step() {
+    switch (state) {
+    case INITIAL_GRADIENT: {
+        fn_grad = std::move(result.gradient);
+        if (preconditioner) {
+            preconditioner->apply(fn_grad, pn);
+        } else {
+            pn = fn_grad;
+        }
+        for (auto &el : pn) el = -el;
+
+        // Fletcher-Reeves continuation of the saved direction
+        const std::vector<double>& old_grad = warm_start.gradient;
+        const std::vector<double>& old_dir = warm_start.direction;
+        if (old_dir.size() == pn.size() && old_grad.size() == pn.size()) {
+            last_slope = dot(pool.get(), old_grad, old_dir);
+            double old_norm = dot(pool.get(), old_grad, old_grad);
+            if (old_norm >= 1e-8) {
+                double beta = dot(pool.get(), fn_grad, fn_grad) / old_norm;
+                std::vector<double> p = pn;
+                for (size_t i = 0; i < p.size(); ++i) {
+                    p[i] += beta * old_dir[i];
+                }
+                if (dot(pool.get(), p, fn_grad) < 0) pn = std::move(p);
+            }
+        }
+        warm_start = CGState();
+        begin_iteration();
+        break;
+    }
+
+    case RESTRICTION:
+        restriction = std::move(result.restriction);
+        use_restriction = restriction != nullptr;
+        begin_line_search();
+        break;
+
+    case LINE_SEARCH: {
+        OPTIM_TRACE_SCOPE("line search");
+        if (line_search_kind == ELineSearch::K_SECTION) {
+            std::vector<double> derivatives(result.gradients.size());
+            for (size_t j = 0; j < derivatives.size(); ++j) {
+                derivatives[j] = dot(pool.get(), result.gradients[j], pn);
+            }
+            k_section.update(derivatives);
+            if (k_section.is_active()) {
+                request_k_section_probes();
+            } else {
+                end_line_search();
+            }
+            break;
+        }
+        double derivative = dot(pool.get(), result.gradient, pn);
+        if (secant) {
+            secant_search.update(derivative);
+            if (secant_search.is_active()) {
+                request_probe(secant_search.get_probe());
+            } else {
+                // the new point is the last probe, its gradient is known
+                fn1_grad = std::move(result.gradient);
+                end_line_search();
+            }
+        } else {
+            line_search.update(derivative);
+            if (line_search.is_active()) {
+                request_probe(line_search.get_probe());
+            } else {
+                end_line_search();
+            }
+        }
+        break;
+    }
+
+    case NEW_GRADIENT:
+        fn1_grad = std::move(result.gradient);
+        new_gradient();
+        break;
+
+    case PROGRESS_VALUE:
+        publish_progress(trajectory.size(), result.value, std::sqrt(grad_norm2));
+        update_direction();
+        break;
+
+    case FINAL_VALUE:
+        best_params.minimum_point = xn;
+        best_params.iter_number = trajectory.size();
+        best_params.minimum_value = result.value;
+        best_params.cancelled = cancelled;
+        done = true;
+        break;
+    }
+}
+
+void ConjugateGradientStepper::begin_iteration() {
+    checkpoint(trajectory.size());
+    bool met;
+    {
+        OPTIM_TRACE_SCOPE("criterion check");
+        met = criterion.done(trajectory);
+    }
+    if (met) {
+        finish();
+        return;
+    }
+    if (is_cancelled()) {
+        cancelled = true;
+        finish();
+        return;
+    }
+    if (use_restriction) {
+        state = RESTRICTION;
+        request_line_restriction(xn, pn);
+        return;
+    }
+    begin_line_search();
+}
+
+void ConjugateGradientStepper::begin_line_search() {
+    double distance = area.intersect(xn, pn); //Должно возвращать расстояние до границы в направлении pn.
+    secant = false;
+    if (line_search_kind == ELineSearch::ADAPTIVE) {
+        slope = dot(pool.get(), fn_grad, pn);
+        secant = last_step > 0 && last_slope < 0 && slope < 0 && distance > 0;
+    }
+    if (restriction) {
+        search_restriction(distance);
+        return;
+    }
+    if (secant) {
+        secant_search.begin(slope, last_step * last_slope / slope, distance);
+        state = LINE_SEARCH;
+        request_probe(secant_search.get_probe());
+        return;
+    }
+    if (line_search_kind == ELineSearch::K_SECTION) {
+        k_section.begin(0, distance);
+        if (k_section.is_active()) {
+            state = LINE_SEARCH;
+            request_k_section_probes();
+        } else {
+            end_line_search();
+        }
+        return;
+    }
+    line_search.begin(0, distance);
+    if (line_search.is_active()) {
+        state = LINE_SEARCH;
+        request_probe(line_search.get_probe());
+    } else {
+        end_line_search();
+    }
+}
+
+void ConjugateGradientStepper::search_restriction(double distance) {
+    OPTIM_TRACE_SCOPE("line search");
+    // same searches as with requests, phi'(alpha) replaces g(x + alpha p)^T p
+    if (secant) {
+        secant_search.begin(slope, last_step * last_slope / slope, distance);
+        while (secant_search.is_active()) {
+            secant_search.update(restriction->derivative(secant_search.get_probe()));
+        }
+    } else if (line_search_kind == ELineSearch::K_SECTION) {
+        k_section.begin(0, distance);
+        std::vector<double> derivatives;
+        while (k_section.is_active()) {
+            std::vector<double> probes = k_section.get_probes();
+            derivatives.resize(probes.size());
+            for (size_t j = 0; j < probes.size(); ++j) {
+                derivatives[j] = restriction->derivative(probes[j]);
+            }
+            k_section.update(derivatives);
+        }
+    } else {
+        line_search.begin(0, distance);
+        while (line_search.is_active()) {
+            line_search.update(restriction->derivative(line_search.get_probe()));
+        }
+    }
+    end_line_search();
+}
+
+void ConjugateGradientStepper::request_probe(double alpha) {
+    std::vector<double> point(xn.size());
+    for (size_t i = 0; i < xn.size(); ++i) {
+        point[i] = xn[i] + alpha * pn[i];
+    }
+    request_gradient(std::move(point));
+}
+
+void ConjugateGradientStepper::request_k_section_probes() {
+    std::vector<double> probes = k_section.get_probes();
+    std::vector<std::vector<double>> points(probes.size(), std::vector<double>(xn.size()));
+    for (size_t j = 0; j < probes.size(); ++j) {
+        for (size_t i = 0; i < xn.size(); ++i) {
+            points[j][i] = xn[i] + probes[j] * pn[i];
+        }
+    }
+    request_gradients(std::move(points));
+}
+
+void ConjugateGradientStepper::set_k_section_points(size_t points) {
+    k_section = KSectionLineSearch(points);
+}
+
+void ConjugateGradientStepper::end_line_search() {
+    double alpha_n = secant ? secant_search.get_result()
+                   : line_search_kind == ELineSearch::K_SECTION ? k_section.get_result()
+                   : line_search.get_result();
+    last_step = alpha_n;
+    last_slope = slope;
+    for (size_t i = 0; i < xn.size(); ++i) {
+        xn[i] = xn[i] + alpha_n * pn[i];
+    }
+    trajectory.push_back(xn);
+    // without a restriction the last secant probe was the new point
+    if (secant && !restriction) {
+        new_gradient();
+        return;
+    }
+    restriction = nullptr;
+    state = NEW_GRADIENT;
+    request_gradient(xn);
+}
+
+void ConjugateGradientStepper::new_gradient() {
+    if (preconditioner) {
+        precondition();
+    } else {
+        numerator = dot(pool.get(), fn1_grad, fn1_grad);
+        denominator = dot(pool.get(), fn_grad, fn_grad);
+        grad_norm2 = numerator;
+    }
+    if (reports_progress()) {
+        state = PROGRESS_VALUE;
+        request_value(xn);
+    } else {
+        update_direction();
+    }
+}
+
+void ConjugateGradientStepper::update_direction() {
+    bool converged = preconditioner ? !(denominator > 0) || grad_norm2 < 1e-10
+                                    : denominator < 1e-8 || numerator < 1e-10;
+    if (converged) {
+        fn_grad = std::move(fn1_grad);
+        finish();
+        return;
+    }
+    {
+        OPTIM_TRACE_SCOPE("direction update");
+        double beta = numerator / denominator;
+        const std::vector<double>& z = preconditioner ? zn1 : fn1_grad;
+        for (size_t i = 0; i < pn.size(); ++i) {
+            pn[i] = -z[i] + beta * pn[i];
+        }
+        ++cycle_iters;
+        if (preconditioner && preconditioner->restart(cycle_iters)) {
+            // M has changed, the new cycle starts from -M^{-1} g
+            preconditioner->apply(fn1_grad, zn1);
+            for (size_t i = 0; i < pn.size(); ++i) {
+                pn[i] = -zn1[i];
+            }
+            cycle_iters = 0;
+        } else if (preconditioner && dot(pool.get(), pn, fn1_grad) >= 0) {
+            // rounding may still break descent
+            for (size_t i = 0; i < pn.size(); ++i) {
+                pn[i] = -z[i];
+            }
+            cycle_iters = 0;
+        }
+        fn_grad = std::move(fn1_grad);
+    }
+    begin_iteration();
+}
+
+void ConjugateGradientStepper::precondition() {
+    OPTIM_TRACE_SCOPE("preconditioner update");
+    std::vector<double> s(xn.size());
+    std::vector<double> y(xn.size());
+    for (size_t i = 0; i < xn.size(); ++i) {
+        s[i] = last_step * pn[i];
+        y[i] = fn1_grad[i] - fn_grad[i];
+    }
+    preconditioner->update(s, y);
+    // both terms of beta use the updated M
+    std::vector<double> zn;
+    preconditioner->apply(fn_grad, zn);
+    preconditioner->apply(fn1_grad, zn1);
+    numerator = dot(pool.get(), fn1_grad, zn1);
+    denominator = dot(pool.get(), fn_grad, zn);
+    grad_norm2 = dot(pool.get(), fn1_grad, fn1_grad);
+}
+
+void ConjugateGradientStepper::finish() {
+    state = FINAL_VALUE;
+    request_value(xn);
+}
+
+
+RandomSearchStepper::RandomSearchStepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    std::vector<double> x0,
+    Philox4x32 gen,
+    double delta0, double p, size_t max_iters,
+    double alpha, double min_delta,
+    std::shared_ptr<Sampler> sampler
+) : area(area), criterion(criterion), gen(gen), sampler(std::move(sampler)), p(p),
+    max_iters(max_iters), alpha(alpha), min_delta(min_delta), state(INITIAL_VALUE),
+    xn(std::move(x0)), delta(delta0)
+{
+    if (xn.size() == 0) {
+        xn = sample_area();
+    }
+    trajectory.push_back(xn);
+    request_value(xn);
+}
+
+RandomSearchStepper::RandomSearchStepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    BinaryReader& in,
+    double p, size_t max_iters,
+    double alpha, double min_delta,
+    std::shared_ptr<Sampler> sampler
+) : area(area), criterion(criterion), sampler(std::move(sampler)), p(p),
+    max_iters(max_iters), alpha(alpha), min_delta(min_delta), state(CANDIDATE_VALUE)
+{
+    read_checkpoint_header(in, ECheckpoint::RANDOM_SEARCH);
+    std::uint64_t seed = in.read_u64();
+    std::uint64_t stream = in.read_u64();
+    gen = Philox4x32(seed, stream);
+    gen.set_position(in.read_u64());
+    delta = in.read_double();
+    fxn = in.read_double();
+    iters = in.read_u64();
+    xn = in.read_vector();
+    trajectory = this->criterion.restore(in);
+    if (xn.size() != this->area.get_dim()) {
+        throw std::invalid_argument("Checkpoint has incompatible dimention.");
+    }
+    if (in.read_u64() != static_cast<std::uint64_t>(this->sampler != nullptr)) {
+        throw std::invalid_argument("Checkpoint sampler does not match the method settings.");
+    }
+    if (this->sampler) {
+        this->sampler->restore(in);
+    }
+    next_candidate();
+}
+
+void RandomSearchStepper::save(BinaryWriter& out) const {
+    write_checkpoint_header(out, ECheckpoint::RANDOM_SEARCH);
+    out.write_u64(gen.get_seed());
+    out.write_u64(gen.get_stream());
+    out.write_u64(gen.get_position());
+    out.write_double(delta);
+    out.write_double(fxn);
+    out.write_u64(iters);
+    out.write_vector(xn);
+    criterion.save(trajectory, out);
+    out.write_u64(sampler != nullptr);
+    if (sampler) {
+        sampler->save(out);
+    }
+}
+
+void RandomSearchStepper::step() {
+    switch (state) {
+    case INITIAL_VALUE:
+        fxn = result.value;
+        state = CANDIDATE_VALUE;
+        next_candidate();
+        break;
+
+    case CANDIDATE_VALUE:
+        if (result.value < fxn) {
+            trajectory.push_back(y);
+            xn = y;
+            fxn = result.value;
+            if (neighborhood) delta = alpha * delta;
+        }
+        ++iters;
+        publish_progress(iters, fxn);
+        next_candidate();
+        break;
+    }
+}
+
+void RandomSearchStepper::next_candidate() {
+    checkpoint(iters);
+    bool stop;
+    {
+        OPTIM_TRACE_SCOPE("criterion check");
+        stop = criterion.done(trajectory) || iters >= max_iters;
+    }
+    if (!stop && is_cancelled()) {
+        best_params.cancelled = true;
+        stop = true;
+    }
+    if (stop) {
+        best_params.iter_number = iters;
+        best_params.minimum_point = xn;
+        best_params.minimum_value = fxn;
+        done = true;
+        return;
+    }
+
+    {
+        OPTIM_TRACE_SCOPE("sample candidate");
+        double beta = gen.uniform();
+        neighborhood = false;
+        if (beta < p && delta > min_delta) {
+            y = area.intersect_rectangle(Cube(xn, delta, true)).sample_random_point(gen);
+            neighborhood = true;
+        } else {
+            y = sample_area();
+        }
+    }
+    request_value(y);
+}
+
+std::vector<double> RandomSearchStepper::sample_area() {
+    if (sampler) return area.sample_point(*sampler);
+    return area.sample_random_point(gen);
+}
+
+
+NewtonCGStepper::NewtonCGStepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    std::vector<double> x0,
+    size_t max_inner_iters
+) : area(area), criterion(criterion),
+    max_inner_iters(max_inner_iters ? max_inner_iters : x0.size()),
+    state(INITIAL_VALUE), xn(std::move(x0))
+{
+    request_value(xn);
+}
+
+void NewtonCGStepper::step() {
+    switch (state) {
+    case INITIAL_VALUE:
+        fxn = result.value;
+        state = GRADIENT;
+        request_gradient(xn);
+        break;
+
+    case GRADIENT:
+        grad = std::move(result.gradient);
+        prev_grad_norm = grad_norm;
+        grad_norm = std::sqrt(dot(nullptr, grad, grad));
+        if (!trajectory.empty()) {
+            publish_progress(trajectory.size(), fxn, grad_norm);
+            // Eisenstat-Walker choice 2 with gamma = 0.9, alpha = 2
+            double eta = 0.9 * (grad_norm / prev_grad_norm) * (grad_norm / prev_grad_norm);
+            double safeguard = 0.9 * forcing * forcing;
+            if (safeguard > 0.1) eta = std::max(eta, safeguard);
+            forcing = std::min(eta, 0.5);
+        }
+        begin_iteration();
+        break;
+
+    case INNER_PRODUCT:
+        inner_step(result.gradient);
+        break;
+
+    case LINE_SEARCH:
+        // Armijo condition
+        if (result.value <= fxn + 1e-4 * step_length * slope) {
+            for (size_t i = 0; i < xn.size(); ++i) {
+                xn[i] += step_length * pn[i];
+            }
+            fxn = result.value;
+            trajectory.push_back(xn);
+            state = GRADIENT;
+            request_gradient(xn);
+        } else {
+            step_length /= 2;
+            if (step_length < 1e-12) {
+                finish();
+            } else {
+                request_trial();
+            }
+        }
+        break;
+    }
+}
+
+void NewtonCGStepper::begin_iteration() {
+    if (criterion.done(trajectory) || grad_norm * grad_norm < 1e-10) {
+        finish();
+        return;
+    }
+    if (is_cancelled()) {
+        cancelled = true;
+        finish();
+        return;
+    }
+    pn.assign(xn.size(), 0);
+    residual = grad;
+    for (auto& el : residual) el = -el;
+    inner_dir = residual;
+    residual_norm2 = grad_norm * grad_norm;
+    inner_iters = 0;
+    state = INNER_PRODUCT;
+    request_hessian_vector(xn, inner_dir);
+}
+
+void NewtonCGStepper::inner_step(const std::vector<double>& hd) {
+    double curvature = dot(nullptr, inner_dir, hd);
+    if (curvature <= 1e-12 * dot(nullptr, inner_dir, inner_dir)) {
+        // negative curvature: keep the last iterate, or steepest descent
+        if (inner_iters == 0) pn = inner_dir;
+        begin_line_search();
+        return;
+    }
+    double alpha = residual_norm2 / curvature;
+    for (size_t i = 0; i < pn.size(); ++i) {
+        pn[i] += alpha * inner_dir[i];
+        residual[i] -= alpha * hd[i];
+    }
+    ++inner_iters;
+    double new_norm2 = dot(nullptr, residual, residual);
+    if (std::sqrt(new_norm2) <= forcing * grad_norm || inner_iters >= max_inner_iters) {
+        begin_line_search();
+        return;
+    }
+    double beta = new_norm2 / residual_norm2;
+    residual_norm2 = new_norm2;
+    for (size_t i = 0; i < inner_dir.size(); ++i) {
+        inner_dir[i] = residual[i] + beta * inner_dir[i];
+    }
+    request_hessian_vector(xn, inner_dir);
+}
+
+void NewtonCGStepper::begin_line_search() {
+    slope = dot(nullptr, grad, pn);
+    double distance = area.intersect(xn, pn);
+    // full Newton step unless it leaves the area
+    step_length = std::min(1., distance);
+    if (slope >= 0 || step_length <= 0) {
+        finish();
+        return;
+    }
+    state = LINE_SEARCH;
+    request_trial();
+}
+
+void NewtonCGStepper::request_trial() {
+    std::vector<double> point(xn.size());
+    for (size_t i = 0; i < xn.size(); ++i) {
+        point[i] = xn[i] + step_length * pn[i];
+    }
+    request_value(std::move(point));
+}
+
+void NewtonCGStepper::finish() {
+    best_params.minimum_point = xn;
+    best_params.minimum_value = fxn;
+    best_params.iter_number = trajectory.size();
+    best_params.cancelled = cancelled;
+    done = true;
+}
+
+
+CoordinateNewtonStepper::CoordinateNewtonStepper(
+    const Rectangle& area,
+    const Criterion& criterion,
+    std::vector<double> x0
+) : criterion(criterion), state(GRADIENT), xn(std::move(x0))
+{
+    for (const auto& [lo, hi] : area.get_bounding_box()) {
+        lower.push_back(lo);
+        upper.push_back(hi);
+    }
+    request_gradient(xn);
+}
+
+void CoordinateNewtonStepper::step() {
+    switch (state) {
+    case GRADIENT:
+        grad = std::move(result.gradient);
+        if (is_cancelled()) cancelled = true;
+        if (cancelled || criterion.done(trajectory)) {
+            state = FINAL_VALUE;
+            request_value(xn);
+            break;
+        }
+        state = CURVATURE;
+        request_hessian_vector(xn, std::vector<double>(xn.size(), 1.));
+        break;
+
+    case CURVATURE:
+        update_coordinates(result.gradient);
+        trajectory.push_back(xn);
+        state = GRADIENT;
+        request_gradient(xn);
+        break;
+
+    case FINAL_VALUE:
+        best_params.minimum_point = xn;
+        best_params.minimum_value = result.value;
+        best_params.iter_number = trajectory.size();
+        best_params.cancelled = cancelled;
+        done = true;
+        break;
+    }
+}
+
+void CoordinateNewtonStepper::update_coordinates(const std::vector<double>& curvature) {
+    OPTIM_TRACE_SCOPE("coordinate newton step");
+    for (size_t i = 0; i < xn.size(); ++i) {
+        // the sign of the derivative tells which side of x holds the minimum
+        if (grad[i] > 0) {
+            upper[i] = xn[i];
+        } else if (grad[i] < 0) {
+            lower[i] = xn[i];
+        } else {
+            lower[i] = upper[i] = xn[i];
+            continue;
+        }
+        double newton = xn[i] - grad[i] / curvature[i];
+        // bracket ends are accepted, near the root the step rounds to x
+        if (curvature[i] > 0 && newton >= lower[i] && newton <= upper[i]) {
+            xn[i] = newton;
+        } else {
+            xn[i] = (lower[i] + upper[i]) / 2;
+        }
+    }
+}
+
+void run_stepper(OptimizationStepper& stepper, const Function<>& func, ThreadPool* pool) {
+    while (!stepper.is_done()) {
+        stepper.evaluate(func, pool);
+    }
+}
+
+void run_interleaved(const std::vector<OptimizationStepper*>& steppers,
+                     const BatchEvaluator& evaluate)
+{
+    std::vector<OptimizationStepper*> active;
+    std::vector<const EvaluationRequest*> requests;
+    std::vector<EvaluationResult> results;
+    while (true) {
+        active.clear();
+        requests.clear();
+        for (auto stepper : steppers) {
+            if (!stepper->is_done()) {
+                active.push_back(stepper);
+                requests.push_back(&stepper->get_request());
+            }
+        }
+        if (active.empty()) break;
+
+        results.assign(requests.size(), EvaluationResult());
+        evaluate(requests, results);
+        for (size_t i = 0; i < active.size(); ++i) {
+            active[i]->tell(std::move(results[i]));
+        }
+    }
+}
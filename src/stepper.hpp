@@ -0,0 +1,683 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cmath>
+
+#include "area.hpp"
+#include "async.hpp"
+#include "checkpoint.hpp"
+#include "function.hpp"
+#include "preconditioner.hpp"
+#include "stop_criterion.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * @brief Struct that contains best params
+ * for OptimizationMethos class
+ *
+ */
+struct BestParams {
+    std::vector<double> minimum_point;
+    double minimum_value = 0;
+    size_t iter_number = 0;
+    bool cancelled = false;
+};
+
+/**
+ * @brief Objective evaluation that a stepper waits for.
+ *
+ */
+struct EvaluationRequest {
+    enum Kind {
+        VALUE,
+        GRADIENT,
+        HESSIAN_VECTOR,
+        /// independent gradients at points, may be computed concurrently
+        GRADIENT_BATCH,
+        /// Function::restrict_to_line at point along direction
+        LINE_RESTRICTION
+    };
+    Kind kind;
+    std::vector<double> point;
+    /// vector multiplied by the Hessian for HESSIAN_VECTOR requests,
+    /// line direction for LINE_RESTRICTION requests
+    std::vector<double> direction;
+    std::vector<std::vector<double>> points;
+};
+
+/**
+ * @brief Answer to EvaluationRequest. Only the field matching
+ * the request kind is read, Hessian-vector products go to gradient.
+ *
+ */
+struct EvaluationResult {
+    double value;
+    std::vector<double> gradient;
+    /// gradients[i] answers points[i] of GRADIENT_BATCH requests
+    std::vector<std::vector<double>> gradients;
+    /// answer to LINE_RESTRICTION, nullptr if the function has no fast path
+    std::shared_ptr<const LineRestriction> restriction;
+};
+
+/**
+ * @brief Base class for resumable optimizers. A stepper never calls
+ * the objective itself: it publishes an EvaluationRequest and suspends
+ * until tell() delivers the result, so many steppers can share a thread.
+ *
+ */
+class OptimizationStepper {
+public:
+    virtual ~OptimizationStepper() = default;
+
+    bool is_done() const {return done;}
+
+    /**
+     * @brief Pending evaluation, valid while is_done() is false.
+     *
+     * @return const EvaluationRequest&
+     */
+    const EvaluationRequest& get_request() const {return request;}
+
+    /**
+     * @brief Resumes the stepper with the result of get_request().
+     *
+     * @param result
+     */
+    void tell(EvaluationResult result);
+
+    /**
+     * @brief Answers the pending request with func.
+     *
+     * @param func
+     * @param pool evaluates points of GRADIENT_BATCH requests concurrently,
+     * nullptr means serially
+     */
+    void evaluate(const Function<>& func, ThreadPool* pool = nullptr);
+
+    const BestParams& get_best_params() const {return best_params;}
+
+    void set_cancellation_token(CancellationToken token) {
+        cancel_token = std::move(token);
+    }
+
+    void set_progress_channel(std::shared_ptr<ProgressChannel> channel) {
+        progress = std::move(channel);
+    }
+
+    /**
+     * @brief Submits the stepper state to writer every `every` iterations.
+     * 
+     * @param writer nullptr disables checkpoints
+     * @param every 
+     */
+    void set_checkpoint(std::shared_ptr<CheckpointWriter> writer, size_t every) {
+        checkpoint_writer = std::move(writer);
+        checkpoint_every = every;
+    }
+
+protected:
+    bool done = false;
+    EvaluationRequest request;
+    EvaluationResult result;
+    BestParams best_params{};
+    CancellationToken cancel_token;
+    std::shared_ptr<ProgressChannel> progress;
+    std::shared_ptr<CheckpointWriter> checkpoint_writer;
+    size_t checkpoint_every = 0;
+
+    /**
+     * @brief Advances the state machine after result was received,
+     * must end with a new request or with done set.
+     *
+     */
+    virtual void step() = 0;
+
+    void request_value(std::vector<double> x);
+    void request_gradient(std::vector<double> x);
+    void request_hessian_vector(std::vector<double> x, std::vector<double> v);
+    void request_gradients(std::vector<std::vector<double>> points);
+    void request_line_restriction(std::vector<double> x, std::vector<double> v);
+
+    bool is_cancelled() const {return cancel_token.is_cancelled();}
+    bool reports_progress() const {return progress != nullptr;}
+    void publish_progress(size_t iteration, double best_value,
+                          double gradient_norm = std::nan(""));
+
+    /**
+     * @brief Serializes everything needed to continue from the start
+     * of the current iteration, including the checkpoint header.
+     * 
+     * @param out 
+     */
+    virtual void save(BinaryWriter& out) const;
+
+    /**
+     * @brief Called at the start of every iteration, saves the state
+     * if a checkpoint is due.
+     * 
+     * @param iteration 
+     */
+    void checkpoint(size_t iteration) const;
+};
+
+/**
+ * @brief Resumable binary search on the sign of the derivative.
+ *
+ */
+class BisectionLineSearch {
+    double epsilon;
+    double left = 0;
+    double right = 0;
+    size_t iter_number = 0;
+
+public:
+    BisectionLineSearch(double epsilon = 1e-4) : epsilon(epsilon) {}
+
+    void begin(double left, double right);
+
+    bool is_active() const {return right - left > epsilon;}
+
+    /**
+     * @brief Point where the derivative is needed next.
+     *
+     * @return double
+     */
+    double get_probe() const {return (left + right) / 2;}
+
+    void update(double derivative);
+
+    double get_result() const {return (left + right) / 2;}
+
+    size_t get_iter_number() const {return iter_number;}
+};
+
+/**
+ * @brief Resumable k-section search on the sign of the derivative.
+ * Every round needs the derivative at k interior points of the interval,
+ * which are independent and can be computed concurrently, and shrinks
+ * the interval k + 1 times. With k = 1 it is BisectionLineSearch.
+ *
+ */
+class KSectionLineSearch {
+    double epsilon;
+    size_t k;
+    double left = 0;
+    double right = 0;
+    size_t iter_number = 0;
+
+public:
+    KSectionLineSearch(size_t k = 3, double epsilon = 1e-4);
+
+    void begin(double left, double right);
+
+    bool is_active() const {return right - left > epsilon;}
+
+    /**
+     * @brief Points where derivatives are needed next, in increasing order.
+     *
+     * @return std::vector<double>
+     */
+    std::vector<double> get_probes() const;
+
+    /**
+     * @brief Keeps the subinterval where the derivative changes sign.
+     *
+     * @param derivatives derivatives[j] is taken at get_probes()[j]
+     */
+    void update(const std::vector<double>& derivatives);
+
+    double get_result() const {return (left + right) / 2;}
+
+    size_t get_iter_number() const {return iter_number;}
+};
+
+/**
+ * @brief Resumable line search that starts from a predicted step.
+ * The trial step is doubled until the derivative turns positive (or the
+ * maximum step is reached), then the bracket is shrunk by secant steps on
+ * the derivative, i.e. minimizers of the quadratic interpolating the
+ * derivatives at the bracket ends. Stops when
+ * |derivative| <= sigma * |derivative at 0|, the accepted step is
+ * always the last probe.
+ *
+ */
+class SecantLineSearch {
+    double sigma;
+    size_t max_iters;
+    double slope0 = 0;
+    double max_step = 0;
+    double lo = 0;
+    double lo_derivative = 0;
+    double hi = 0;
+    double hi_derivative = 0;
+    double probe = 0;
+    bool bracketed = false;
+    bool active = false;
+    size_t iter_number = 0;
+
+public:
+    SecantLineSearch(double sigma = 0.01, size_t max_iters = 50) :
+        sigma(sigma), max_iters(max_iters) {}
+
+    /**
+     * @brief Starts a search on [0, max_step].
+     *
+     * @param slope0 derivative at 0, negative
+     * @param guess first trial step
+     * @param max_step
+     */
+    void begin(double slope0, double guess, double max_step);
+
+    bool is_active() const {return active;}
+
+    double get_probe() const {return probe;}
+
+    void update(double derivative);
+
+    double get_result() const {return probe;}
+
+    size_t get_iter_number() const {return iter_number;}
+};
+
+/**
+ * @brief Line search used by ConjugateGradientStepper.
+ *
+ */
+enum class ELineSearch {
+    /// bisection over the whole interval to the area boundary
+    BISECTION,
+    /// SecantLineSearch from the step predicted by the previous iteration
+    ADAPTIVE,
+    /// KSectionLineSearch over the whole interval, probes of a round
+    /// are requested as one GRADIENT_BATCH
+    K_SECTION
+};
+
+/**
+ * @brief Step-wise version of OneDimentionalOptimization.
+ *
+ */
+class OneDimentionalStepper : public OptimizationStepper {
+public:
+    OneDimentionalStepper(const Rectangle& area, double epsilon);
+
+protected:
+    void step() override;
+
+private:
+    enum EState {
+        SEARCH,
+        FINAL_VALUE
+    };
+
+    BisectionLineSearch line_search;
+    EState state;
+
+    void next_probe();
+};
+
+/**
+ * @brief State of conjugate gradient method sufficient to continue
+ * optimization of a slightly changed function.
+ * 
+ */
+struct CGState {
+    std::vector<double> point;
+    std::vector<double> direction;
+    /// gradient at point of the function the state was saved from
+    std::vector<double> gradient;
+    double step_length = 0;
+};
+
+/**
+ * @brief Step-wise version of ConjugateGradientMethod. Every line
+ * search first asks for the restriction of the function to the line
+ * and, if the function provides one, probes it without further
+ * requests. Functions without a fast path are asked only once.
+ *
+ */
+class ConjugateGradientStepper : public OptimizationStepper {
+public:
+    /**
+     * @brief Construct a new Conjugate Gradient Stepper object
+     *
+     * @param area must outlive the stepper
+     * @param criterion must outlive the stepper
+     * @param x0 starting point
+     */
+    ConjugateGradientStepper(const Rectangle& area, const Criterion& criterion,
+                             std::vector<double> x0);
+
+    /**
+     * @brief Continues from a saved state. Gradient is recomputed at the
+     * saved point, the saved direction is kept as conjugate direction
+     * if it still descends.
+     * 
+     * @param area must outlive the stepper
+     * @param criterion must outlive the stepper
+     * @param warm_start point must lie in the area
+     */
+    ConjugateGradientStepper(const Rectangle& area, const Criterion& criterion,
+                             CGState warm_start);
+
+    /**
+     * @brief Continues bit-exactly from a checkpoint written by
+     * a stepper with the same area and criterion.
+     * 
+     * @param area must outlive the stepper
+     * @param criterion must outlive the stepper
+     * @param in positioned at the checkpoint header
+     */
+    ConjugateGradientStepper(const Rectangle& area, const Criterion& criterion,
+                             BinaryReader& in);
+
+    /**
+     * @brief Current state, after finishing it can warm start next solve.
+     * 
+     * @return CGState 
+     */
+    CGState get_state() const;
+
+    /**
+     * @brief Pool for dot product reductions, nullptr means serial.
+     * 
+     * @param pool 
+     */
+    void set_thread_pool(std::shared_ptr<ThreadPool> pool) {
+        this->pool = std::move(pool);
+    }
+
+    /**
+     * @brief Directions are built from M^{-1} g instead of g.
+     * 
+     * @param preconditioner nullptr disables preconditioning
+     */
+    void set_preconditioner(std::shared_ptr<Preconditioner> preconditioner) {
+        this->preconditioner = std::move(preconditioner);
+    }
+
+    /**
+     * @brief ADAPTIVE (default) predicts the step as
+     * alpha_{n-1} g_{n-1}^T p_{n-1} / g_n^T p_n and usually needs
+     * 2-4 gradients, the first iteration always bisects.
+     * 
+     * @param kind 
+     */
+    void set_line_search(ELineSearch kind) {line_search_kind = kind;}
+
+    /**
+     * @brief Number of probes per round of K_SECTION line search.
+     * 
+     * @param points at least one
+     */
+    void set_k_section_points(size_t points);
+
+protected:
+    void step() override;
+    void save(BinaryWriter& out) const override;
+
+private:
+    enum EState {
+        INITIAL_GRADIENT,
+        RESTRICTION,
+        LINE_SEARCH,
+        NEW_GRADIENT,
+        PROGRESS_VALUE,
+        FINAL_VALUE
+    };
+
+    /// used through its virtuals, so subclasses keep their behaviour
+    const Rectangle& area;
+    const Criterion& criterion;
+    /// cleared once the function answers without a fast path
+    bool use_restriction = true;
+    /// restriction of the function to the current line
+    std::shared_ptr<const LineRestriction> restriction;
+    BisectionLineSearch line_search;
+    SecantLineSearch secant_search;
+    KSectionLineSearch k_section;
+    ELineSearch line_search_kind = ELineSearch::ADAPTIVE;
+    bool secant = false;
+    EState state;
+    std::shared_ptr<ThreadPool> pool;
+    std::shared_ptr<Preconditioner> preconditioner;
+
+    std::vector<double> xn;
+    std::vector<double> pn;
+    std::vector<double> fn_grad;
+    std::vector<double> fn1_grad;
+    /// M^{-1} fn1_grad when preconditioned
+    std::vector<double> zn1;
+    double grad_norm2 = 0;
+    /// steps since the last restart
+    size_t cycle_iters = 0;
+    std::vector<std::vector<double>> trajectory;
+    double numerator = 0;
+    double denominator = 0;
+    double last_step = 0;
+    /// g^T p at the start of the current and of the previous line search
+    double slope = 0;
+    double last_slope = 0;
+    bool cancelled = false;
+    CGState warm_start;
+
+    void begin_iteration();
+    void begin_line_search();
+    void search_restriction(double distance);
+    void request_probe(double alpha);
+    void request_k_section_probes();
+    void end_line_search();
+    void new_gradient();
+    void update_direction();
+    void precondition();
+    void finish();
+};
+
+/**
+ * @brief Step-wise version of RandomSearch.
+ *
+ */
+class RandomSearchStepper : public OptimizationStepper {
+public:
+    /**
+     * @brief Construct a new Random Search Stepper object
+     *
+     * @param area must outlive the stepper
+     * @param criterion must outlive the stepper
+     * @param x0 starting point, sampled from area if empty
+     * @param gen generator, stepper draws from its own copy
+     * @param sampler source of points sampled from the whole area,
+     * nullptr means uniform points from gen
+     */
+    RandomSearchStepper(const Rectangle& area, const Criterion& criterion,
+                        std::vector<double> x0, Philox4x32 gen,
+                        double delta0, double p, size_t max_iters,
+                        double alpha, double min_delta,
+                        std::shared_ptr<Sampler> sampler = nullptr);
+
+    /**
+     * @brief Continues bit-exactly from a checkpoint, generator included.
+     * Settings are not stored in the checkpoint and must match the run
+     * that wrote it.
+     * 
+     * @param area must outlive the stepper
+     * @param criterion must outlive the stepper
+     * @param in positioned at the checkpoint header
+     * @param sampler restored from the checkpoint, must be given
+     * exactly when the checkpointed run used one
+     */
+    RandomSearchStepper(const Rectangle& area, const Criterion& criterion,
+                        BinaryReader& in, double p, size_t max_iters,
+                        double alpha, double min_delta,
+                        std::shared_ptr<Sampler> sampler = nullptr);
+
+    const Philox4x32& get_generator() const {return gen;}
+
+protected:
+    void step() override;
+    void save(BinaryWriter& out) const override;
+
+private:
+    enum EState {
+        INITIAL_VALUE,
+        CANDIDATE_VALUE
+    };
+
+    /// used through its virtuals, so subclasses keep their behaviour
+    const Rectangle& area;
+    const Criterion& criterion;
+    Philox4x32 gen;
+    std::shared_ptr<Sampler> sampler;
+    double p;
+    size_t max_iters;
+    double alpha;
+    double min_delta;
+    EState state;
+
+    std::vector<double> xn;
+    std::vector<double> y;
+    double fxn = 0;
+    double delta;
+    bool neighborhood = false;
+    size_t iters = 0;
+    std::vector<std::vector<double>> trajectory;
+
+    void next_candidate();
+    std::vector<double> sample_area();
+};
+
+/**
+ * @brief Step-wise version of NewtonConjugateGradient.
+ *
+ */
+class NewtonCGStepper : public OptimizationStepper {
+public:
+    /**
+     * @brief Construct a new Newton CG Stepper object
+     *
+     * @param area must outlive the stepper
+     * @param criterion must outlive the stepper
+     * @param x0 starting point
+     * @param max_inner_iters limit of inner CG iterations, 0 means dimention
+     */
+    NewtonCGStepper(const Rectangle& area, const Criterion& criterion,
+                    std::vector<double> x0, size_t max_inner_iters = 0);
+
+protected:
+    void step() override;
+
+private:
+    enum EState {
+        INITIAL_VALUE,
+        GRADIENT,
+        INNER_PRODUCT,
+        LINE_SEARCH
+    };
+
+    /// used through its virtuals, so subclasses keep their behaviour
+    const Rectangle& area;
+    const Criterion& criterion;
+    size_t max_inner_iters;
+    EState state;
+
+    std::vector<double> xn;
+    double fxn = 0;
+    std::vector<double> grad;
+    double grad_norm = 0;
+    double prev_grad_norm = 0;
+    double forcing = 0.5;
+    std::vector<std::vector<double>> trajectory;
+    bool cancelled = false;
+
+    // inner CG on H p = -grad
+    std::vector<double> pn;
+    std::vector<double> residual;
+    std::vector<double> inner_dir;
+    double residual_norm2 = 0;
+    size_t inner_iters = 0;
+
+    // backtracking along pn
+    double step_length = 0;
+    double slope = 0;
+
+    void begin_iteration();
+    void inner_step(const std::vector<double>& hd);
+    void begin_line_search();
+    void request_trial();
+    void finish();
+};
+
+/**
+ * @brief Step-wise version of CoordinateNewtonMethod. Every iteration
+ * requests the gradient and the Hessian-vector product with ones, which
+ * is the Hessian diagonal of a separable function, then takes a
+ * safeguarded Newton step on every coordinate independently. Reports
+ * no progress and does not support checkpoints.
+ *
+ */
+class CoordinateNewtonStepper : public OptimizationStepper {
+public:
+    /**
+     * @brief Construct a new Coordinate Newton Stepper object
+     *
+     * @param area only its bounding box is read
+     * @param criterion must outlive the stepper
+     * @param x0 starting point
+     */
+    CoordinateNewtonStepper(const Rectangle& area, const Criterion& criterion,
+                            std::vector<double> x0);
+
+protected:
+    void step() override;
+
+private:
+    enum EState {
+        GRADIENT,
+        CURVATURE,
+        FINAL_VALUE
+    };
+
+    const Criterion& criterion;
+    EState state;
+
+    std::vector<double> xn;
+    std::vector<double> grad;
+    /// the minimum of term i lies in [lower[i], upper[i]]
+    std::vector<double> lower;
+    std::vector<double> upper;
+    std::vector<std::vector<double>> trajectory;
+    bool cancelled = false;
+
+    void update_coordinates(const std::vector<double>& curvature);
+};
+
+/**
+ * @brief Runs stepper to completion, evaluating requests with func.
+ *
+ * @param stepper
+ * @param func
+ * @param pool see OptimizationStepper::evaluate
+ */
+void run_stepper(OptimizationStepper& stepper, const Function<>& func, ThreadPool* pool = nullptr);
+
+/**
+ * @brief Evaluates a batch of requests, results[i] answers *requests[i].
+ * Must handle every EvaluationRequest kind the steppers may ask for,
+ * LINE_RESTRICTION may always be answered with nullptr.
+ *
+ */
+using BatchEvaluator = std::function<void(const std::vector<const EvaluationRequest*>& requests,
+                                          std::vector<EvaluationResult>& results)>;
+
+/**
+ * @brief Interleaves many steppers on the current thread. Every round
+ * collects pending requests of all unfinished steppers and passes them
+ * to evaluate as one batch.
+ *
+ * @param steppers
+ * @param evaluate
+ */
+void run_interleaved(const std::vector<OptimizationStepper*>& steppers,
+                     const BatchEvaluator& evaluate);
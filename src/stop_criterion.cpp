@@ -1,5 +1,44 @@
 #include "stop_criterion.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
+#include "checkpoint.hpp"
+
+namespace {
+
+/**
+ * @brief Iteration count followed by the last `last` points.
+ *
+ */
+void save_tail(const std::vector<std::vector<double>>& trajectory, size_t last, BinaryWriter& out) {
+    size_t kept = std::min(last, trajectory.size());
+    out.write_u64(trajectory.size());
+    out.write_matrix({trajectory.end() - kept, trajectory.end()});
+}
+
+std::vector<std::vector<double>> restore_tail(BinaryReader& in) {
+    std::uint64_t size = in.read_u64();
+    std::vector<std::vector<double>> tail = in.read_matrix();
+    if (tail.size() > size) {
+        throw std::invalid_argument("Checkpoint has inconsistent trajectory.");
+    }
+    std::vector<std::vector<double>> trajectory(size - tail.size());
+    for (auto& point : tail) trajectory.push_back(std::move(point));
+    return trajectory;
+}
+
+}
+
+void Criterion::save(const std::vector<std::vector<double>>& trajectory, BinaryWriter& out) const {
+    out.write_matrix(trajectory);
+}
+
+std::vector<std::vector<double>> Criterion::restore(BinaryReader& in) const {
+    return in.read_matrix();
+}
+
+
 IterationCriterion::IterationCriterion(size_t max_iter) : max_iter(max_iter) {}
 
 bool IterationCriterion::done(const std::vector<std::vector<double>>& trajectory) const {
@@ -7,6 +46,14 @@ bool IterationCriterion::done(const std::vector<std::vector<double>>& trajectory
     return false;
 }
 
+void IterationCriterion::save(const std::vector<std::vector<double>>& trajectory, BinaryWriter& out) const {
+    save_tail(trajectory, 0, out);
+}
+
+std::vector<std::vector<double>> IterationCriterion::restore(BinaryReader& in) const {
+    return restore_tail(in);
+}
+
 
 EpsilonCriterion::EpsilonCriterion(double epsilon) : epsilon(epsilon) {}
 
@@ -14,10 +61,18 @@ bool EpsilonCriterion::done(const std::vector<std::vector<double>>& trajectory)
     if (trajectory.size() < 2) return false;
 
     double dist = 0;
-    for (size_t i=0; i < trajectory[0].size(); ++i) {
+    for (size_t i=0; i < trajectory.back().size(); ++i) {
         double d = trajectory[trajectory.size()-1][i] - trajectory[trajectory.size()-2][i];
         dist += d * d;
     }
     if (dist < epsilon * epsilon) return true;
     return false;
-}
\ No newline at end of file
+}
+
+void EpsilonCriterion::save(const std::vector<std::vector<double>>& trajectory, BinaryWriter& out) const {
+    save_tail(trajectory, 2, out);
+}
+
+std::vector<std::vector<double>> EpsilonCriterion::restore(BinaryReader& in) const {
+    return restore_tail(in);
+}
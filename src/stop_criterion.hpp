@@ -3,6 +3,9 @@
 #include <vector>
 #include <string>
 
+class BinaryWriter;
+class BinaryReader;
+
 /**
  * @brief Implements stop criteria for optimization methods
  * 
@@ -20,6 +23,24 @@ public:
      */
     virtual bool done(const std::vector<std::vector<double>>& trajectory) const = 0;
     virtual std::string get_name() const = 0;
+
+    /**
+     * @brief Writes the part of trajectory that done reads,
+     * by default all of it.
+     *
+     * @param trajectory
+     * @param out
+     */
+    virtual void save(const std::vector<std::vector<double>>& trajectory, BinaryWriter& out) const;
+
+    /**
+     * @brief Reads what save wrote. done answers for the result as for
+     * the saved trajectory, points it does not read may be left empty.
+     *
+     * @param in
+     * @return std::vector<std::vector<double>>
+     */
+    virtual std::vector<std::vector<double>> restore(BinaryReader& in) const;
 };
 
 /**
@@ -36,6 +57,13 @@ public:
     std::string get_name() const override {
         return "Iteration Criterion";
     }
+
+    /**
+     * @brief Saves the number of iterations only.
+     *
+     */
+    void save(const std::vector<std::vector<double>>& trajectory, BinaryWriter& out) const override;
+    std::vector<std::vector<double>> restore(BinaryReader& in) const override;
 };
 
 /**
@@ -54,4 +82,11 @@ public:
     std::string get_name() const override {
         return "Epsilon Criterion";
     }
+
+    /**
+     * @brief Saves the number of iterations and the last two points.
+     *
+     */
+    void save(const std::vector<std::vector<double>>& trajectory, BinaryWriter& out) const override;
+    std::vector<std::vector<double>> restore(BinaryReader& in) const override;
 };
\ No newline at end of file
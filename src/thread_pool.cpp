@@ -0,0 +1,129 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+ThreadPool::ThreadPool(size_t num_threads, bool pin_threads) {
+    if (num_threads == 0) num_threads = 1;
+    workers.reserve(num_threads);
+#ifdef __linux__
+    // hardware_concurrency may report 0 when it is unknown
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+#endif
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+#ifdef __linux__
+        if (pin_threads) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % cores, &set);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t begin, size_t end)>& body) {
+    std::lock_guard<std::mutex> submit_lock(submit_mutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &body;
+    task_size = n;
+    remaining = workers.size();
+    error = nullptr;
+    ++generation;
+    start_cv.notify_all();
+    done_cv.wait(lock, [this]() {return remaining == 0;});
+    task = nullptr;
+    if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    size_t seen = 0;
+    while (true) {
+        const std::function<void(size_t, size_t)>* body;
+        size_t n;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [this, seen]() {return stop || generation != seen;});
+            if (stop) return;
+            seen = generation;
+            body = task;
+            n = task_size;
+        }
+
+        size_t begin = n * index / workers.size();
+        size_t end = n * (index + 1) / workers.size();
+        std::exception_ptr local_error;
+        if (begin < end) {
+            try {
+                (*body)(begin, end);
+            }
+            catch (...) {
+                local_error = std::current_exception();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (local_error && !error) error = local_error;
+        if (--remaining == 0) done_cv.notify_one();
+    }
+}
+
+
+double deterministic_sum(ThreadPool* pool, size_t n,
+                         const std::function<double(size_t begin, size_t end)>& block_sum)
+{
+    size_t blocks = (n + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+    if (blocks == 0) return 0;
+    std::vector<double> partial(blocks);
+    auto run = [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t last = std::min(n, (b + 1) * REDUCTION_BLOCK);
+            partial[b] = block_sum(b * REDUCTION_BLOCK, last);
+        }
+    };
+    if (pool && blocks > 1) {
+        pool->parallel_for(blocks, run);
+    } else {
+        run(0, blocks);
+    }
+
+    for (size_t width = 1; width < blocks; width *= 2) {
+        for (size_t i = 0; i + width < blocks; i += 2 * width) {
+            partial[i] += partial[i + width];
+        }
+    }
+    return partial[0];
+}
+
+double dot(ThreadPool* pool, const std::vector<double>& a, const std::vector<double>& b) {
+    if (!pool) {
+        double res = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            res += a[i] * b[i];
+        }
+        return res;
+    }
+    return deterministic_sum(pool, a.size(), [&](size_t begin, size_t end) {
+        double res = 0;
+        for (size_t i = begin; i < end; ++i) {
+            res += a[i] * b[i];
+        }
+        return res;
+    });
+}
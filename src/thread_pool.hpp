@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/**
+ * @brief Persistent pool of worker threads with static work splitting.
+ * Chunk k of every parallel_for runs on worker k, so memory first
+ * touched by a worker in one call is used by the same worker later.
+ *
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Construct a new Thread Pool object
+     *
+     * @param num_threads number of workers, at least one
+     * @param pin_threads if true, worker k is bound to cpu k (Linux only)
+     */
+    ThreadPool(size_t num_threads = std::thread::hardware_concurrency(),
+               bool pin_threads = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t get_num_threads() const {return workers.size();}
+
+    /**
+     * @brief Splits [0, n) into get_num_threads() contiguous chunks and
+     * blocks until body has run on all of them. Must not be called
+     * from inside body.
+     *
+     * @param n
+     * @param body receives [begin, end) of its chunk
+     */
+    void parallel_for(size_t n, const std::function<void(size_t begin, size_t end)>& body);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex submit_mutex;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::function<void(size_t, size_t)>* task = nullptr;
+    size_t task_size = 0;
+    size_t generation = 0;
+    size_t remaining = 0;
+    bool stop = false;
+    std::exception_ptr error;
+
+    void worker_loop(size_t index);
+};
+
+/**
+ * @brief Number of elements summed sequentially before the tree
+ * reduction. Fixed, so results do not depend on the thread count.
+ *
+ */
+constexpr size_t REDUCTION_BLOCK = 1024;
+
+/**
+ * @brief Sums block_sum over consecutive REDUCTION_BLOCK sized blocks of
+ * [0, n) and combines partial sums by a pairwise tree of fixed shape.
+ * Result is the same for any pool, including nullptr (serial).
+ *
+ * @param pool
+ * @param n
+ * @param block_sum returns the sum over [begin, end)
+ * @return double
+ */
+double deterministic_sum(ThreadPool* pool, size_t n,
+                         const std::function<double(size_t begin, size_t end)>& block_sum);
+
+/**
+ * @brief Dot product a^T b. Without pool it is a plain sequential loop,
+ * with pool it is computed by deterministic_sum.
+ *
+ * @param pool
+ * @param a
+ * @param b
+ * @return double
+ */
+double dot(ThreadPool* pool, const std::vector<double>& a, const std::vector<double>& b);
@@ -0,0 +1,155 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    std::uint64_t start_ns;
+    std::uint64_t duration_ns;
+};
+
+/**
+ * @brief Events of one thread in a list of fixed chunks. Only the owner
+ * appends; count is published with release, so readers see complete
+ * events without locking.
+ *
+ */
+struct TraceChunk {
+    static constexpr size_t CAPACITY = 4096;
+
+    TraceEvent events[CAPACITY];
+    std::atomic<size_t> count{0};
+    std::atomic<TraceChunk*> next{nullptr};
+};
+
+struct TraceBuffer {
+    size_t tid;
+    TraceChunk head;
+    /// accessed by the owner only
+    TraceChunk* tail = &head;
+
+    TraceBuffer(size_t tid) : tid(tid) {}
+
+    ~TraceBuffer() {
+        TraceChunk* chunk = head.next.load();
+        while (chunk) {
+            TraceChunk* next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+
+    void append(const TraceEvent& event) {
+        size_t n = tail->count.load(std::memory_order_relaxed);
+        if (n == TraceChunk::CAPACITY) {
+            TraceChunk* chunk = new TraceChunk();
+            tail->next.store(chunk, std::memory_order_release);
+            tail = chunk;
+            n = 0;
+        }
+        tail->events[n] = event;
+        tail->count.store(n + 1, std::memory_order_release);
+    }
+
+    void clear() {
+        TraceChunk* chunk = head.next.exchange(nullptr);
+        while (chunk) {
+            TraceChunk* next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+        head.count.store(0);
+        tail = &head;
+    }
+};
+
+std::atomic<bool> trace_enabled{false};
+
+/// buffers live until exit, so events of finished threads are kept
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<TraceBuffer>>& registry() {
+    static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    return buffers;
+}
+
+#ifdef OPTIM_TRACE
+
+const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+std::uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+TraceBuffer& thread_buffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry().push_back(std::make_unique<TraceBuffer>(registry().size() + 1));
+        buffer = registry().back().get();
+    }
+    return *buffer;
+}
+
+#endif
+
+}
+
+void trace_enable(bool enabled) {
+    trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void trace_write(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Can not open trace file " + path);
+    // microseconds with nanosecond resolution
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& buffer : registry()) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << buffer->tid << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+        first = false;
+        for (const TraceChunk* chunk = &buffer->head; chunk;
+             chunk = chunk->next.load(std::memory_order_acquire))
+        {
+            size_t n = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; ++i) {
+                const TraceEvent& event = chunk->events[i];
+                out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"ts\":" << event.start_ns / 1e3 << ",\"dur\":" << event.duration_ns / 1e3 << "}";
+            }
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+void trace_clear() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& buffer : registry()) {
+        buffer->clear();
+    }
+}
+
+#ifdef OPTIM_TRACE
+
+TraceScope::TraceScope(const char* name) :
+    name(trace_enabled.load(std::memory_order_relaxed) ? name : nullptr),
+    start_ns(this->name ? now_ns() : 0) {}
+
+TraceScope::~TraceScope() {
+    if (!name) return;
+    thread_buffer().append({name, start_ns, now_ns() - start_ns});
+}
+
+#endif
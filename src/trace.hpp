@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/**
+ * Timeline of solver phases in Chrome trace event format, viewable in
+ * chrome://tracing or Perfetto. Trace points are OPTIM_TRACE_SCOPE("name")
+ * statements with string literal names; each records one complete event
+ * into a buffer owned by the calling thread, without locks.
+ *
+ * Without the OPTIM_TRACE definition (CMake option OPTIM_TRACE) trace
+ * points compile to nothing and trace_write writes an empty trace.
+ */
+
+/**
+ * @brief Starts or pauses recording, off by default.
+ *
+ * @param enabled
+ */
+void trace_enable(bool enabled);
+
+/**
+ * @brief Writes events of all threads recorded so far as Chrome trace
+ * JSON. Can run concurrently with traced code, events recorded during
+ * the call may be missing.
+ *
+ * @param path
+ */
+void trace_write(const std::string& path);
+
+/**
+ * @brief Drops recorded events. No traced code may run meanwhile.
+ *
+ */
+void trace_clear();
+
+#ifdef OPTIM_TRACE
+
+/**
+ * @brief Records [construction, destruction) as one event.
+ *
+ */
+class TraceScope {
+public:
+    TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    std::uint64_t start_ns;
+};
+
+#define OPTIM_TRACE_CONCAT_IMPL(a, b) a##b
+#define OPTIM_TRACE_CONCAT(a, b) OPTIM_TRACE_CONCAT_IMPL(a, b)
+#define OPTIM_TRACE_SCOPE(name) TraceScope OPTIM_TRACE_CONCAT(optim_trace_scope_, __LINE__)(name)
+
+#else
+
+#define OPTIM_TRACE_SCOPE(name) ((void)0)
+
+#endif
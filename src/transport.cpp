@@ -0,0 +1,341 @@
+#include "transport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void Transport::broadcast(std::vector<double>& values) {
+    if (rank == 0) {
+        for (int r = 1; r < size; ++r) {
+            send(r, values.data(), values.size() * sizeof(double));
+        }
+    } else {
+        recv(0, values.data(), values.size() * sizeof(double));
+    }
+}
+
+void Transport::allreduce_sum(std::vector<double>& values) {
+    if (rank == 0) {
+        std::vector<double> other(values.size());
+        for (int r = 1; r < size; ++r) {
+            recv(r, other.data(), other.size() * sizeof(double));
+            for (size_t i = 0; i < values.size(); ++i) {
+                values[i] += other[i];
+            }
+        }
+    } else {
+        send(0, values.data(), values.size() * sizeof(double));
+    }
+    broadcast(values);
+}
+
+double Transport::allreduce_sum(double value) {
+    std::vector<double> values = {value};
+    allreduce_sum(values);
+    return values[0];
+}
+
+std::vector<double> Transport::allgather(const std::vector<double>& local) {
+    std::vector<std::uint64_t> sizes(size);
+    std::uint64_t local_size = local.size();
+    std::vector<double> result;
+    if (rank == 0) {
+        sizes[0] = local_size;
+        for (int r = 1; r < size; ++r) {
+            recv(r, &sizes[r], sizeof(std::uint64_t));
+        }
+        result = local;
+        for (int r = 1; r < size; ++r) {
+            size_t offset = result.size();
+            result.resize(offset + sizes[r]);
+            recv(r, result.data() + offset, sizes[r] * sizeof(double));
+        }
+        std::uint64_t total = result.size();
+        for (int r = 1; r < size; ++r) {
+            send(r, &total, sizeof(std::uint64_t));
+        }
+    } else {
+        send(0, &local_size, sizeof(std::uint64_t));
+        send(0, local.data(), local.size() * sizeof(double));
+        std::uint64_t total;
+        recv(0, &total, sizeof(std::uint64_t));
+        result.resize(total);
+    }
+    broadcast(result);
+    return result;
+}
+
+void Transport::barrier() {
+    allreduce_sum(0.);
+}
+
+
+namespace {
+
+/**
+ * @brief Byte ring buffer with one writer and one reader process.
+ *
+ */
+struct ShmChannel {
+    static constexpr size_t CAPACITY = 1 << 18;
+
+    alignas(64) std::atomic<std::uint64_t> head;
+    alignas(64) std::atomic<std::uint64_t> tail;
+    char data[CAPACITY];
+};
+
+/**
+ * @brief Rank states shared by all processes: a rank sets its flag when
+ * its body returns or throws, so peers waiting for it stop waiting.
+ *
+ */
+struct ShmControl {
+    alignas(64) std::atomic<std::uint32_t> exited;
+};
+
+class SharedMemoryTransport : public Transport {
+public:
+    SharedMemoryTransport(int rank, int size, ShmChannel* channels, ShmControl* control,
+                          std::chrono::milliseconds timeout) :
+        Transport(rank, size), channels(channels), control(control), timeout(timeout) {}
+
+    void send(int dest, const void* data, size_t bytes) override {
+        ShmChannel& ch = channels[rank * size + dest];
+        const char* src = static_cast<const char*>(data);
+        std::uint64_t t = ch.tail.load(std::memory_order_relaxed);
+        Waiter waiter(*this, dest);
+        while (bytes) {
+            size_t free = ShmChannel::CAPACITY - (t - ch.head.load(std::memory_order_acquire));
+            if (free == 0) {
+                waiter.wait([&]() {return ch.head.load(std::memory_order_acquire) != t - ShmChannel::CAPACITY;});
+                continue;
+            }
+            size_t pos = t % ShmChannel::CAPACITY;
+            size_t chunk = std::min({free, bytes, ShmChannel::CAPACITY - pos});
+            std::memcpy(ch.data + pos, src, chunk);
+            src += chunk;
+            bytes -= chunk;
+            t += chunk;
+            ch.tail.store(t, std::memory_order_release);
+            waiter.progress();
+        }
+    }
+
+    void recv(int src, void* data, size_t bytes) override {
+        ShmChannel& ch = channels[src * size + rank];
+        char* dst = static_cast<char*>(data);
+        std::uint64_t h = ch.head.load(std::memory_order_relaxed);
+        Waiter waiter(*this, src);
+        while (bytes) {
+            size_t available = ch.tail.load(std::memory_order_acquire) - h;
+            if (available == 0) {
+                waiter.wait([&]() {return ch.tail.load(std::memory_order_acquire) != h;});
+                continue;
+            }
+            size_t pos = h % ShmChannel::CAPACITY;
+            size_t chunk = std::min({available, bytes, ShmChannel::CAPACITY - pos});
+            std::memcpy(dst, ch.data + pos, chunk);
+            dst += chunk;
+            bytes -= chunk;
+            h += chunk;
+            ch.head.store(h, std::memory_order_release);
+            waiter.progress();
+        }
+    }
+
+private:
+    /**
+     * @brief Spin-wait on one peer that gives up when the peer exited
+     * or nothing moved for the timeout (e.g. the peer was killed).
+     *
+     */
+    class Waiter {
+    public:
+        Waiter(const SharedMemoryTransport& transport, int peer) :
+            transport(transport), peer(peer), since(std::chrono::steady_clock::now()) {}
+
+        void progress() {
+            spins = 0;
+            since = std::chrono::steady_clock::now();
+        }
+
+        template <typename Ready>
+        void wait(Ready&& ready) {
+            std::this_thread::yield();
+            if (++spins % 1024 != 0) return;
+            if (transport.control[peer].exited.load(std::memory_order_acquire)) {
+                // the peer published everything before exiting
+                if (ready()) return;
+                throw std::runtime_error("Rank " + std::to_string(peer) + " exited during communication.");
+            }
+            if (std::chrono::steady_clock::now() - since > transport.timeout) {
+                throw std::runtime_error("Rank " + std::to_string(peer) + " did not respond in time.");
+            }
+        }
+
+    private:
+        const SharedMemoryTransport& transport;
+        int peer;
+        std::chrono::steady_clock::time_point since;
+        size_t spins = 0;
+    };
+
+    ShmChannel* channels;
+    ShmControl* control;
+    std::chrono::milliseconds timeout;
+};
+
+class UnixSocketTransport : public Transport {
+public:
+    UnixSocketTransport(int rank, int size, std::vector<int> fds) :
+        Transport(rank, size), fds(std::move(fds)) {}
+
+    ~UnixSocketTransport() override {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    void send(int dest, const void* data, size_t bytes) override {
+        const char* src = static_cast<const char*>(data);
+        while (bytes) {
+            // no SIGPIPE when the peer is gone, the error is thrown instead
+            ssize_t n = ::send(fds[dest], src, bytes, MSG_NOSIGNAL);
+            if (n < 0) throw std::runtime_error("Unix socket write failed.");
+            src += n;
+            bytes -= n;
+        }
+    }
+
+    void recv(int src, void* data, size_t bytes) override {
+        char* dst = static_cast<char*>(data);
+        while (bytes) {
+            ssize_t n = read(fds[src], dst, bytes);
+            if (n <= 0) throw std::runtime_error("Unix socket read failed.");
+            dst += n;
+            bytes -= n;
+        }
+    }
+
+private:
+    std::vector<int> fds;
+};
+
+}
+
+void run_distributed(int size, ETransport kind, const std::function<void(Transport&)>& body,
+                     std::chrono::milliseconds timeout)
+{
+    if (size < 1) throw std::invalid_argument("Number of ranks must be positive.");
+
+    ShmChannel* channels = nullptr;
+    ShmControl* control = nullptr;
+    size_t shm_bytes = 0;
+    // sockets[i][j] is the end of the i <-> j connection owned by rank i
+    std::vector<std::vector<int>> sockets(size, std::vector<int>(size, -1));
+
+    if (kind == ETransport::SHARED_MEMORY) {
+        std::string name = "/cgm-transport-" + std::to_string(getpid());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) throw std::runtime_error("shm_open failed.");
+        shm_bytes = sizeof(ShmChannel) * size * size + sizeof(ShmControl) * size;
+        if (ftruncate(fd, shm_bytes) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error("ftruncate of shared memory failed.");
+        }
+        void* mem = mmap(nullptr, shm_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        // the mapping stays valid for this process and its children
+        shm_unlink(name.c_str());
+        if (mem == MAP_FAILED) throw std::runtime_error("mmap of shared memory failed.");
+        channels = static_cast<ShmChannel*>(mem);
+        control = reinterpret_cast<ShmControl*>(channels + size * size);
+        for (int i = 0; i < size * size; ++i) {
+            new (&channels[i].head) std::atomic<std::uint64_t>(0);
+            new (&channels[i].tail) std::atomic<std::uint64_t>(0);
+        }
+        for (int i = 0; i < size; ++i) {
+            new (&control[i].exited) std::atomic<std::uint32_t>(0);
+        }
+    } else {
+        for (int i = 0; i < size; ++i) {
+            for (int j = i + 1; j < size; ++j) {
+                int pair[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                    throw std::runtime_error("socketpair failed.");
+                }
+                sockets[i][j] = pair[0];
+                sockets[j][i] = pair[1];
+            }
+        }
+    }
+
+    auto make_transport = [&](int rank) -> std::unique_ptr<Transport> {
+        if (kind == ETransport::SHARED_MEMORY) {
+            return std::make_unique<SharedMemoryTransport>(rank, size, channels, control, timeout);
+        }
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) {
+                if (i != rank && sockets[i][j] >= 0) close(sockets[i][j]);
+            }
+        }
+        return std::make_unique<UnixSocketTransport>(rank, size, sockets[rank]);
+    };
+    auto mark_exited = [&](int rank) {
+        if (control) control[rank].exited.store(1, std::memory_order_release);
+    };
+
+    std::vector<pid_t> workers;
+    for (int rank = 1; rank < size; ++rank) {
+        pid_t pid = fork();
+        if (pid < 0) throw std::runtime_error("fork failed.");
+        if (pid == 0) {
+            int status = 0;
+            try {
+                auto transport = make_transport(rank);
+                body(*transport);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "rank " << rank << ": " << e.what() << "\n";
+                status = 1;
+            }
+            mark_exited(rank);
+            _exit(status);
+        }
+        workers.push_back(pid);
+    }
+
+    std::exception_ptr error;
+    try {
+        auto transport = make_transport(0);
+        body(*transport);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    mark_exited(0);
+
+    bool workers_failed = false;
+    for (pid_t pid : workers) {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) workers_failed = true;
+    }
+    if (channels) munmap(channels, shm_bytes);
+
+    if (error) std::rethrow_exception(error);
+    if (workers_failed) throw std::runtime_error("Distributed worker failed.");
+}
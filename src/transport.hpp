@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <cstddef>
+#include <functional>
+
+/**
+ * @brief Point-to-point byte transport between worker processes.
+ * Collectives are built on top of send/recv through rank 0 and combine
+ * contributions in rank order, so they are deterministic.
+ *
+ */
+class Transport {
+public:
+    Transport(int rank, int size) : rank(rank), size(size) {}
+    virtual ~Transport() = default;
+
+    int get_rank() const {return rank;}
+    int get_size() const {return size;}
+
+    /**
+     * @brief Blocks until all bytes are handed to the transport.
+     *
+     * @param dest
+     * @param data
+     * @param bytes
+     */
+    virtual void send(int dest, const void* data, size_t bytes) = 0;
+
+    /**
+     * @brief Blocks until exactly bytes are received from src.
+     *
+     * @param src
+     * @param data
+     * @param bytes
+     */
+    virtual void recv(int src, void* data, size_t bytes) = 0;
+
+    /**
+     * @brief Elementwise sum of values over all ranks, result on every rank.
+     *
+     * @param values
+     */
+    void allreduce_sum(std::vector<double>& values);
+
+    double allreduce_sum(double value);
+
+    /**
+     * @brief Concatenates local parts of all ranks in rank order,
+     * result on every rank.
+     *
+     * @param local
+     * @return std::vector<double>
+     */
+    std::vector<double> allgather(const std::vector<double>& local);
+
+    void barrier();
+
+protected:
+    int rank;
+    int size;
+
+    void broadcast(std::vector<double>& values);
+};
+
+enum class ETransport {
+    SHARED_MEMORY,
+    UNIX_SOCKET
+};
+
+/**
+ * @brief Forks size - 1 worker processes and runs body on every rank,
+ * the calling process is rank 0. Returns after all workers exited.
+ * Must be called before the process starts other threads. When a rank
+ * dies, send and recv of its peers throw std::runtime_error instead of
+ * blocking forever: at once for sockets and after the rank's body
+ * returned or threw (or after timeout, e.g. if it was killed) for
+ * shared memory.
+ *
+ * @param size number of ranks
+ * @param kind transport connecting the ranks
+ * @param body
+ * @param timeout longest shared memory wait without progress
+ */
+void run_distributed(int size, ETransport kind, const std::function<void(Transport&)>& body,
+                     std::chrono::milliseconds timeout = std::chrono::minutes(1));